@@ -0,0 +1,236 @@
+/*
+    CgroupManager.cpp - cgroup v2 based liveness for managed services
+
+    Why cgroups instead of process names?
+    -------------------------------------
+    Matching /proc/[pid]/comm says "some process with this name exists". It cannot tell our service
+    apart from an unrelated process that happens to share the name, and for multi-process applications
+    (see the Chrome note in the README) it only works as long as every helper keeps the same name.
+    A cgroup contains exactly the processes started into it and everything they fork, so
+    "is the service running?" becomes "is its cgroup populated?", which the kernel answers in
+    cgroup.events and announces through inotify (IN_MODIFY) whenever it changes.
+
+    Layout: <root>/<service>/ with the service name sanitised into a valid directory name; a name that
+    had to be changed gets a hash of itself appended, and a directory name already in use is refused.
+    The root (default /sys/fs/cgroup/watchdog) must be on a cgroup2 mount and writable by the watchdog.
+    No controllers are enabled, so the "no internal processes" rule does not get in the way.
+*/
+
+#include "CgroupManager.h"
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <linux/magic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "Logger.h"
+
+// Helper: FNV-1a of a name, as 8 hex digits
+static std::string nameHash(const std::string& name) {
+    unsigned hash = 2166136261u;
+    for (unsigned char c : name) hash = (hash ^ c) * 16777619u;
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08x", hash);
+    return hex;
+}
+
+// Helper: Turn a service name (which may be a glob or regex) into a valid cgroup directory name.
+// A name that had to be changed gets a hash of the original appended, so "foo bar" and "foo_bar", or
+// "worker-*" and "worker-?", do not end up in one cgroup
+static std::string cgroupDirName(const std::string& service) {
+    std::string dir;
+    for (char c : service) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_' || c == '.';
+        dir += ok ? c : '_';
+    }
+    if (dir.empty() || dir[0] == '.' || dir.compare(0, 7, "cgroup.") == 0) dir = "_" + dir;
+    if (dir != service) dir += "-" + nameHash(service);
+    return dir;
+}
+
+// Helper: mkdir -p for the cgroup root
+static bool makeDirs(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos != path.size() && path[pos] != '/') continue;
+        std::string prefix = path.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+CgroupManager::~CgroupManager() {
+    clear();
+}
+
+void CgroupManager::clear() {
+    for (auto& s : services) {
+        if (s.second.fd >= 0) close(s.second.fd);
+    }
+    services.clear();
+    watches.clear();
+    if (inotifyFd >= 0) close(inotifyFd);
+    if (rootFd >= 0) close(rootFd);
+    inotifyFd = -1;
+    rootFd = -1;
+    rootPath.clear();
+}
+
+bool CgroupManager::init(const std::string& root) {
+    if (rootFd >= 0 && root == rootPath) return true;
+    clear();
+    if (!makeDirs(root)) {
+        logToWindowsEventLog("Cannot create cgroup root " + root + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        return false;
+    }
+    struct statfs fs;
+    if (statfs(root.c_str(), &fs) < 0 || fs.f_type != CGROUP2_SUPER_MAGIC) {
+        logToWindowsEventLog("Cgroup root is not on a cgroup2 mount: " + root, WDOG_LOG_WARNING);
+        return false;
+    }
+    rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (rootFd < 0 || inotifyFd < 0) {
+        clear();
+        return false;
+    }
+    rootPath = root;
+    ++openCount;
+    return true;
+}
+
+bool CgroupManager::addService(const std::string& service) {
+    if (rootFd < 0) return false;
+    if (hasService(service)) return true;
+    Service svc;
+    svc.dir = cgroupDirName(service);
+    // Two services sharing a cgroup would each see the other's processes as their own
+    for (const auto& other : services) {
+        if (other.second.dir != svc.dir) continue;
+        logToWindowsEventLog("Cannot create cgroup for " + service + ": " + svc.dir + " is already the cgroup of " +
+                             other.first, WDOG_LOG_WARNING);
+        return false;
+    }
+    if (mkdirat(rootFd, svc.dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        logToWindowsEventLog("Cannot create cgroup for " + service + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        return false;
+    }
+    svc.fd = openat(rootFd, svc.dir.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    std::string events = rootPath + "/" + svc.dir + "/cgroup.events";
+    svc.watch = inotify_add_watch(inotifyFd, events.c_str(), IN_MODIFY);
+    if (svc.watch < 0) {
+        logToWindowsEventLog("Cannot watch " + events + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        if (svc.fd >= 0) close(svc.fd);
+        return false;
+    }
+    // Read the state only after the watch exists, so no transition can be missed
+    svc.populated = readPopulated(svc);
+    watches[svc.watch] = service;
+    services[service] = svc;
+    return true;
+}
+
+void CgroupManager::removeService(const std::string& service) {
+    auto it = services.find(service);
+    if (it == services.end()) return;
+    inotify_rm_watch(inotifyFd, it->second.watch);
+    watches.erase(it->second.watch);
+    if (it->second.fd >= 0) close(it->second.fd);
+    unlinkat(rootFd, it->second.dir.c_str(), AT_REMOVEDIR); // fails with EBUSY while processes remain
+    services.erase(it);
+}
+
+std::vector<std::string> CgroupManager::serviceNames() const {
+    std::vector<std::string> names;
+    for (const auto& s : services) names.push_back(s.first);
+    return names;
+}
+
+bool CgroupManager::isPopulated(const std::string& service) const {
+    auto it = services.find(service);
+    return it != services.end() && it->second.populated;
+}
+
+void CgroupManager::markPopulated(const std::string& service) {
+    auto it = services.find(service);
+    if (it != services.end()) it->second.populated = true;
+}
+
+void CgroupManager::refresh(const std::string& service) {
+    auto it = services.find(service);
+    if (it != services.end()) it->second.populated = readPopulated(it->second);
+}
+
+int CgroupManager::dirFd(const std::string& service) const {
+    auto it = services.find(service);
+    return it == services.end() ? -1 : it->second.fd;
+}
+
+int CgroupManager::openProcs(const std::string& service) const {
+    auto it = services.find(service);
+    if (it == services.end()) return -1;
+    std::string path = it->second.dir + "/cgroup.procs";
+    return openat(rootFd, path.c_str(), O_WRONLY | O_CLOEXEC);
+}
+
+std::vector<pid_t> CgroupManager::members(const std::string& service) const {
+    std::vector<pid_t> pids;
+    auto it = services.find(service);
+    if (it == services.end()) return pids;
+    std::string path = it->second.dir + "/cgroup.procs";
+    int fd = openat(rootFd, path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return pids;
+    char buf[4096];
+    pid_t pid = 0;
+    bool inNumber = false;
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i] >= '0' && buf[i] <= '9') {
+                pid = pid * 10 + (buf[i] - '0');
+                inNumber = true;
+            } else if (inNumber) {
+                pids.push_back(pid);
+                pid = 0;
+                inNumber = false;
+            }
+        }
+    }
+    if (inNumber) pids.push_back(pid);
+    close(fd);
+    return pids;
+}
+
+// Parses "populated 0|1" out of <service>/cgroup.events
+bool CgroupManager::readPopulated(const Service& svc) const {
+    std::string path = svc.dir + "/cgroup.events";
+    int fd = openat(rootFd, path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[256];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return false;
+    buf[n] = '\0';
+    const char* key = std::strstr(buf, "populated ");
+    return key && key[10] == '1';
+}
+
+void CgroupManager::handleEvents(std::vector<std::string>& emptied) {
+    alignas(inotify_event) char buf[4096];
+    ssize_t n;
+    while ((n = read(inotifyFd, buf, sizeof(buf))) > 0) {
+        for (ssize_t off = 0; off < n;) {
+            const inotify_event* ev = reinterpret_cast<const inotify_event*>(buf + off);
+            off += sizeof(inotify_event) + ev->len;
+            auto w = watches.find(ev->wd);
+            if (w == watches.end()) continue;
+            Service& svc = services[w->second];
+            bool populated = readPopulated(svc);
+            if (svc.populated && !populated) emptied.push_back(w->second);
+            svc.populated = populated;
+        }
+    }
+}
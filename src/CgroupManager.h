@@ -0,0 +1,72 @@
+#pragma once
+#include <sys/types.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Gives managed services their own cgroup v2 directory below a root the watchdog owns, and tracks
+// whether each of them still contains any process.
+// Liveness comes from the "populated" key of <service>/cgroup.events, which the kernel updates (and
+// signals through inotify) the moment the last process of the cgroup exits. That makes the check an
+// O(1) lookup that cannot be fooled by unrelated processes sharing the service's name, and it covers
+// every process a multi-process application forks.
+class CgroupManager {
+public:
+    CgroupManager() = default;
+    ~CgroupManager();
+    CgroupManager(const CgroupManager&) = delete;
+    CgroupManager& operator=(const CgroupManager&) = delete;
+
+    // Creates (if needed) and opens the root directory, which must be on a cgroup2 mount.
+    // Safe to call again with the same root; a different root drops all services first.
+    bool init(const std::string& root);
+    bool isReady() const { return rootFd >= 0; }
+
+    // inotify fd reporting changes to the cgroup.events files of all services
+    int eventFd() const { return inotifyFd; }
+    // Counts the times init opened a new root and inotify fd. A closed inotify fd leaves epoll by itself and
+    // its successor usually gets the same number back, so callers compare this rather than eventFd()
+    unsigned generation() const { return openCount; }
+
+    // Creates the cgroup of a service and starts watching it
+    bool addService(const std::string& service);
+    // Stops watching a service and removes its cgroup if it is empty
+    void removeService(const std::string& service);
+    bool hasService(const std::string& service) const { return services.count(service) > 0; }
+    std::vector<std::string> serviceNames() const;
+
+    // Whether the cgroup of the service contains at least one process
+    bool isPopulated(const std::string& service) const;
+    // Marks a service as populated right after launching into it, before the kernel event arrives
+    void markPopulated(const std::string& service);
+    // Re-reads the populated state of a service, e.g. after a launch into it failed
+    void refresh(const std::string& service);
+
+    // Open O_PATH fd of the service's cgroup directory (for clone3 CLONE_INTO_CGROUP), or -1
+    int dirFd(const std::string& service) const;
+    // Opens <service>/cgroup.procs for writing; a process writing "0" to it moves itself in
+    int openProcs(const std::string& service) const;
+    // PIDs currently in the cgroup of the service
+    std::vector<pid_t> members(const std::string& service) const;
+
+    // Reads pending inotify events and refreshes the populated state of the affected services.
+    // Appends the services that became empty to emptied.
+    void handleEvents(std::vector<std::string>& emptied);
+private:
+    struct Service {
+        std::string dir;  // directory name below the root
+        int watch = -1;   // inotify watch descriptor on cgroup.events
+        int fd = -1;      // the directory itself
+        bool populated = false;
+    };
+
+    bool readPopulated(const Service& svc) const;
+    void clear();
+
+    std::string rootPath;
+    int rootFd = -1;
+    int inotifyFd = -1;
+    unsigned openCount = 0;
+    std::unordered_map<std::string, Service> services;
+    std::unordered_map<int, std::string> watches; // watch descriptor -> service
+};
@@ -26,7 +26,18 @@
     Key Features:
     -------------
     - Reads the config file at startup and on every detected change.
-    - Parses the list of processes and their arguments from JSON.
+    - Parses the list of processes and their arguments from JSON. "args" may be a shell-style command line
+      or an array; either way it is tokenized once here into the argv block of ProcessInfo.
+    - Compiles the process names (exact names, globs and regexes, see "match") into one ProcessMatcher,
+      so the OS layer can classify running processes against all entries in a single pass.
+    - Reads optional top-level settings (see WatchdogSettings), e.g. "scan_threads".
+    - Reads the per-entry "cgroup" flag, which makes the Linux layer run the entry in its own cgroup.
+    - Reads the per-entry "depends_on" list, which the monitor uses to start entries in dependency order,
+      and the "restart" policy ("always" or "on-failure").
+    - Reads the per-entry "listen" addresses, whose sockets the Linux layer holds open across restarts,
+      and the "fd_store" size, how many fds an entry may leave with the watchdog for its next process.
+    - Reads the per-entry "standby" count of idle instances the Linux layer keeps ready for failover,
+      and the "readahead" flag, which has it warm the page cache for the entry's files before restarts.
     - Supports dynamic addition and removal of monitored processes by simply editing and saving config.json.
     - Integrates seamlessly with the rest of the watchdog system for real-time process management.
 */
@@ -41,6 +52,25 @@
 #include "json.hpp" //  JSON library
 using json = nlohmann::json;
 
+// Helper: Parse the optional "match" field of a process entry
+static MatchKind parseMatchKind(const std::string& value) {
+    if (value == "glob") return MatchKind::Glob;
+    if (value == "regex") return MatchKind::Regex;
+    if (value != "exact") {
+        logToWindowsEventLog("Unknown match kind '" + value + "', using exact", WDOG_LOG_WARNING);
+    }
+    return MatchKind::Exact;
+}
+
+// Helper: Parse the optional "restart" field of a process entry
+static RestartPolicy parseRestartPolicy(const std::string& value) {
+    if (value == "on-failure") return RestartPolicy::OnFailure;
+    if (value != "always") {
+        logToWindowsEventLog("Unknown restart policy '" + value + "', using always", WDOG_LOG_WARNING);
+    }
+    return RestartPolicy::Always;
+}
+
 static std::time_t getFileModTime(const std::string& path) {
     struct stat result;
     if (stat(path.c_str(), &result) == 0)
@@ -61,10 +91,52 @@ void ConfigManager::load() {
     json j;
     file >> j;
     processes.clear();
+    std::vector<std::string> argWords;
     for (const auto& p : j["processes"]) {
-        processes.emplace_back(p["name"], p["args"]);
+        // "args" is either a shell-style command line or an array of individual arguments
+        const json& args = p["args"];
+        processes.emplace_back(p["name"], args.is_string() ? args.get<std::string>() : std::string(),
+                               parseMatchKind(p.value("match", "exact")), p.value("exe", ""));
+        if (args.is_array()) {
+            processes.back().setArgv(args.get<std::vector<std::string>>());
+        } else if (!ProcessInfo::splitCommandLine(processes.back().getArgs(), argWords)) {
+            logToWindowsEventLog("Unterminated quote in args of " + processes.back().getName(), WDOG_LOG_WARNING);
+        }
+        processes.back().setUseCgroup(p.value("cgroup", false));
+        processes.back().setRestartPolicy(parseRestartPolicy(p.value("restart", "always")));
+        // "depends_on" names one prerequisite or lists several
+        if (p.contains("depends_on")) {
+            const json& deps = p["depends_on"];
+            processes.back().setDependsOn(deps.is_string() ? std::vector<std::string>(1, deps.get<std::string>())
+                                                           : deps.get<std::vector<std::string>>());
+        }
+        // "listen" is one address or a list of them
+        if (p.contains("listen")) {
+            const json& listen = p["listen"];
+            processes.back().setListen(listen.is_string() ? std::vector<std::string>(1, listen.get<std::string>())
+                                                          : listen.get<std::vector<std::string>>());
+        }
+        processes.back().setFdStore(p.value("fd_store", 0u));
+        processes.back().setStandby(p.value("standby", 0u));
+        processes.back().setReadahead(p.value("readahead", false));
     }
+    matcher = ProcessMatcher(processes);
     foregroundApp = j["foreground"];
+    settings = WatchdogSettings();
+    settings.scanThreads = j.value("scan_threads", settings.scanThreads);
+    settings.ioUring = j.value("io_uring", settings.ioUring);
+    settings.procRoot = j.value("proc_root", settings.procRoot);
+    settings.cgroupRoot = j.value("cgroup_root", settings.cgroupRoot);
+    settings.launchHelper = j.value("launch_helper", settings.launchHelper);
+    settings.startConcurrency = j.value("start_concurrency", settings.startConcurrency);
+    settings.restartDelayMs = j.value("restart_delay_ms", settings.restartDelayMs);
+    settings.restartDelayMaxMs = j.value("restart_delay_max_ms", settings.restartDelayMaxMs);
+    settings.restartBurst = j.value("restart_burst", settings.restartBurst);
+    settings.restartBurstWindow = j.value("restart_burst_window", settings.restartBurstWindow);
+    settings.logDir = j.value("log_dir", settings.logDir);
+    settings.logMaxBytes = j.value("log_max_bytes", settings.logMaxBytes);
+    settings.logTailBytes = j.value("log_tail_bytes", settings.logTailBytes);
+    settings.stopGraceMs = j.value("stop_grace_ms", settings.stopGraceMs);
     lastModified = getFileModTime(filepath);
 }
 
@@ -79,4 +151,6 @@ bool ConfigManager::reloadIfChanged() {
 }
 
 const std::vector<ProcessInfo>& ConfigManager::getProcesses() const { return processes; }
-const std::string& ConfigManager::getForegroundApp() const { return foregroundApp; }
\ No newline at end of file
+const std::string& ConfigManager::getForegroundApp() const { return foregroundApp; }
+const ProcessMatcher& ConfigManager::getMatcher() const { return matcher; }
+const WatchdogSettings& ConfigManager::getSettings() const { return settings; }
\ No newline at end of file
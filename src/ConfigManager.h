@@ -3,6 +3,25 @@
 #include <vector>
 #include <ctime>        
 #include "ProcessInfo.h"
+#include "ProcessMatcher.h"
+
+// Optional top-level settings of config.json. Keys that are absent keep these defaults.
+struct WatchdogSettings {
+    unsigned scanThreads = 1; // "scan_threads": threads for /proc scans on Linux, 0 = one per CPU
+    bool ioUring = false;           // "io_uring": batch the per-PID /proc reads through io_uring on Linux
+    std::string procRoot = "/proc"; // "proc_root": procfs the Linux layer scans
+    std::string cgroupRoot = "/sys/fs/cgroup/watchdog"; // "cgroup_root": parent of the per-service cgroups
+    bool launchHelper = false;      // "launch_helper": start entries from a pre-forked helper process on Linux
+    unsigned startConcurrency = 16; // "start_concurrency": entries started but not yet running, 0 = no limit
+    unsigned restartDelayMs = 1000;     // "restart_delay_ms": delay before the first restart, doubled per stop
+    unsigned restartDelayMaxMs = 60000; // "restart_delay_max_ms": cap of the restart delay
+    unsigned restartBurst = 5;          // "restart_burst": starts allowed per window before failing, 0 = no limit
+    unsigned restartBurstWindow = 60;   // "restart_burst_window": that window, in seconds
+    std::string logDir;                 // "log_dir": capture stdout/stderr of entries into ring logs here (Linux)
+    size_t logMaxBytes = 1024 * 1024;   // "log_max_bytes": size of each ring log file
+    size_t logTailBytes = 4096;         // "log_tail_bytes": output logged with a failed exit, 0 = none
+    unsigned stopGraceMs = 10000;       // "stop_grace_ms": time between SIGTERM and SIGKILL when stopping (Linux)
+};
 
 class ConfigManager {
 public:
@@ -12,11 +31,16 @@ public:
     virtual bool reloadIfChanged();
     virtual const std::vector<ProcessInfo>& getProcesses() const;
     virtual const std::string& getForegroundApp() const;
+    // Matcher compiled from the process list at every (re)load
+    virtual const ProcessMatcher& getMatcher() const;
+    virtual const WatchdogSettings& getSettings() const;
 
     virtual ~ConfigManager() = default;
 private:
     std::string filepath;
     std::vector<ProcessInfo> processes;
     std::string foregroundApp;
+    ProcessMatcher matcher;
+    WatchdogSettings settings;
     std::time_t lastModified = 0; // track last modified time
 };
\ No newline at end of file
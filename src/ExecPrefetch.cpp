@@ -0,0 +1,296 @@
+/*
+    ExecPrefetch.cpp - Page cache warm-up for restarts ("readahead")
+
+    Why?
+    ----
+    Starting a program maps its executable, the dynamic loader and every shared library it needs, and
+    the new process faults those pages in one at a time as it touches them. When the files are cached
+    that costs nothing; on a host under memory pressure they have usually been evicted while the
+    service ran, and a restart then waits on hundreds of small synchronous disk reads.
+    posix_fadvise(POSIX_FADV_WILLNEED) instead queues large readahead for the whole files and returns
+    right away, so the reads run in the background and in big requests. The monitor issues it when an
+    entry's process is reaped, which overlaps the reads with the restart delay, and again right before
+    the entry is started. readahead(2) does the same but blocks until the data is read, which the
+    event loop cannot afford.
+
+    The list of files is worked out once per config load, by reading the ELF program headers and the
+    dynamic section of the executable and of each library it needs, much like ldd does without
+    running the loader.
+*/
+
+#include "ExecPrefetch.h"
+#include <elf.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+// Scripts whose interpreter is a script, and so on, are followed this deep
+static const int kMaxScriptDepth = 4;
+// Most files resolved for one entry
+static const size_t kMaxFiles = 256;
+
+// Helper: Read exactly size bytes at offset
+static bool readAt(int fd, void* buf, size_t size, uint64_t offset) {
+    char* p = static_cast<char*>(buf);
+    while (size > 0) {
+        ssize_t n = pread(fd, p, size, static_cast<off_t>(offset));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Helper: Resolve a program name like execvp: names with a slash are used as they are, others are
+// searched in PATH
+static std::string findProgram(const std::string& exe) {
+    if (exe.find('/') != std::string::npos) return exe;
+    const char* env = std::getenv("PATH");
+    std::string dirs = env != nullptr ? env : "/usr/local/bin:/bin:/usr/bin";
+    size_t start = 0;
+    while (start <= dirs.size()) {
+        size_t end = dirs.find(':', start);
+        if (end == std::string::npos) end = dirs.size();
+        std::string dir = end > start ? dirs.substr(start, end - start) : ".";
+        std::string candidate = dir + "/" + exe;
+        struct stat st;
+        if (stat(candidate.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        start = end + 1;
+    }
+    return std::string();
+}
+
+// Helper: Split a ':'-separated search path, expanding $ORIGIN to the directory of the object
+static std::vector<std::string> splitSearchPath(const std::string& list, const std::string& origin) {
+    std::vector<std::string> dirs;
+    size_t start = 0;
+    while (start < list.size()) {
+        size_t end = list.find(':', start);
+        if (end == std::string::npos) end = list.size();
+        std::string dir = list.substr(start, end - start);
+        for (const char* token : { "${ORIGIN}", "$ORIGIN" }) {
+            size_t at;
+            while ((at = dir.find(token)) != std::string::npos) dir.replace(at, std::strlen(token), origin);
+        }
+        if (!dir.empty()) dirs.push_back(dir);
+        start = end + 1;
+    }
+    return dirs;
+}
+
+// What the dynamic loader reads from an ELF file before it maps the libraries
+struct ElfInfo {
+    unsigned machine = 0;
+    std::string interp;              // PT_INTERP, the dynamic loader
+    std::vector<std::string> needed; // DT_NEEDED
+    std::string rpath;               // DT_RPATH
+    std::string runpath;             // DT_RUNPATH
+};
+
+template <class Ehdr, class Phdr, class Dyn>
+static bool parseElf(int fd, ElfInfo& info) {
+    Ehdr header;
+    if (!readAt(fd, &header, sizeof(header), 0) || header.e_phentsize != sizeof(Phdr) || header.e_phnum == 0 ||
+        header.e_phnum > 512) {
+        return false;
+    }
+    info.machine = header.e_machine;
+    std::vector<Phdr> segments(header.e_phnum);
+    if (!readAt(fd, segments.data(), segments.size() * sizeof(Phdr), header.e_phoff)) return false;
+    const Phdr* dynamic = nullptr;
+    for (const Phdr& segment : segments) {
+        if (segment.p_type == PT_INTERP && segment.p_filesz > 1 && segment.p_filesz < 4096) {
+            std::string interp(segment.p_filesz, '\0');
+            if (readAt(fd, &interp[0], interp.size(), segment.p_offset)) info.interp = interp.c_str();
+        } else if (segment.p_type == PT_DYNAMIC) {
+            dynamic = &segment;
+        }
+    }
+    if (dynamic == nullptr) return true; // static executable
+    std::vector<Dyn> entries(std::min<size_t>(dynamic->p_filesz / sizeof(Dyn), 4096));
+    if (!readAt(fd, entries.data(), entries.size() * sizeof(Dyn), dynamic->p_offset)) return false;
+    uint64_t strtab = 0;
+    uint64_t strsz = 0;
+    std::vector<uint64_t> needed;
+    int64_t rpath = -1;
+    int64_t runpath = -1;
+    for (const Dyn& entry : entries) {
+        if (entry.d_tag == DT_NULL) break;
+        switch (entry.d_tag) {
+            case DT_STRTAB: strtab = entry.d_un.d_ptr; break;
+            case DT_STRSZ: strsz = entry.d_un.d_val; break;
+            case DT_NEEDED: needed.push_back(entry.d_un.d_val); break;
+            case DT_RPATH: rpath = static_cast<int64_t>(entry.d_un.d_val); break;
+            case DT_RUNPATH: runpath = static_cast<int64_t>(entry.d_un.d_val); break;
+        }
+    }
+    if (strtab == 0 || strsz == 0 || strsz > (1u << 20)) return true;
+    // DT_STRTAB is a virtual address; the segment that loads it tells where it is in the file
+    for (const Phdr& segment : segments) {
+        if (segment.p_type != PT_LOAD || strtab < segment.p_vaddr || strtab >= segment.p_vaddr + segment.p_filesz) continue;
+        std::string strings(strsz, '\0');
+        if (!readAt(fd, &strings[0], strings.size(), strtab - segment.p_vaddr + segment.p_offset)) return true;
+        strings.push_back('\0');
+        auto at = [&strings](uint64_t index) {
+            return index < strings.size() ? std::string(strings.c_str() + index) : std::string();
+        };
+        for (uint64_t index : needed) {
+            std::string name = at(index);
+            if (!name.empty()) info.needed.push_back(name);
+        }
+        if (rpath >= 0) info.rpath = at(static_cast<uint64_t>(rpath));
+        if (runpath >= 0) info.runpath = at(static_cast<uint64_t>(runpath));
+        break;
+    }
+    return true;
+}
+
+// Helper: Whether path is an ELF object of the given class and machine, which is what the loader
+// checks before it accepts a library found in a search directory
+static bool isCompatibleElf(const std::string& path, unsigned char elfClass, unsigned machine) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    unsigned char ident[EI_NIDENT + 4];
+    bool ok = readAt(fd, ident, sizeof(ident), 0) && std::memcmp(ident, ELFMAG, SELFMAG) == 0 &&
+              ident[EI_CLASS] == elfClass;
+    close(fd);
+    if (!ok) return false;
+    // e_machine follows e_type right after e_ident in both classes, in the file's byte order
+    unsigned fileMachine = ident[EI_DATA] == ELFDATA2MSB ? (ident[EI_NIDENT + 2] << 8) | ident[EI_NIDENT + 3]
+                                                         : ident[EI_NIDENT + 2] | (ident[EI_NIDENT + 3] << 8);
+    return fileMachine == machine;
+}
+
+// Helper: Add the library directories of an ld.so.conf file and the files it includes
+static void readLdConf(const std::string& file, int depth, std::vector<std::string>& dirs) {
+    std::ifstream in(file);
+    std::string line;
+    while (depth < 8 && std::getline(in, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos) continue;
+        line = line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+        if (line.compare(0, 8, "include ") == 0) {
+            std::string pattern = line.substr(line.find_first_not_of(" \t", 8));
+            if (pattern[0] != '/') pattern = file.substr(0, file.rfind('/') + 1) + pattern;
+            glob_t matches;
+            if (glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+                for (size_t i = 0; i < matches.gl_pathc; ++i) readLdConf(matches.gl_pathv[i], depth + 1, dirs);
+            }
+            globfree(&matches);
+        } else if (line[0] == '/' && std::find(dirs.begin(), dirs.end(), line) == dirs.end()) {
+            dirs.push_back(line);
+        }
+    }
+}
+
+void ExecPrefetch::loadLibraryDirs() {
+    dirsLoaded = true;
+    readLdConf("/etc/ld.so.conf", 0, libraryDirs);
+    for (const char* dir : { "/lib64", "/usr/lib64", "/lib", "/usr/lib" }) {
+        if (std::find(libraryDirs.begin(), libraryDirs.end(), dir) == libraryDirs.end()) libraryDirs.push_back(dir);
+    }
+}
+
+// The loader's search order: DT_RPATH (only without DT_RUNPATH), LD_LIBRARY_PATH, DT_RUNPATH, then the
+// directories of ld.so.conf (what ld.so.cache is built from) and the default ones
+std::string ExecPrefetch::findLibrary(const std::string& name, const std::string& origin,
+                                      const std::vector<std::string>& rpath, const std::vector<std::string>& runpath,
+                                      unsigned char elfClass, unsigned machine) const {
+    if (name.find('/') != std::string::npos) return name;
+    std::vector<std::string> dirs = runpath.empty() ? rpath : std::vector<std::string>();
+    const char* env = std::getenv("LD_LIBRARY_PATH");
+    if (env != nullptr) {
+        std::vector<std::string> extra = splitSearchPath(env, origin);
+        dirs.insert(dirs.end(), extra.begin(), extra.end());
+    }
+    dirs.insert(dirs.end(), runpath.begin(), runpath.end());
+    dirs.insert(dirs.end(), libraryDirs.begin(), libraryDirs.end());
+    for (const std::string& dir : dirs) {
+        std::string candidate = dir + "/" + name;
+        if (isCompatibleElf(candidate, elfClass, machine)) return candidate;
+    }
+    return std::string();
+}
+
+void ExecPrefetch::resolveElf(const std::string& path, int fd, std::vector<std::string>& out) {
+    unsigned char ident[EI_NIDENT];
+    if (!readAt(fd, ident, sizeof(ident), 0)) return;
+    ElfInfo info;
+    bool ok = false;
+    if (ident[EI_CLASS] == ELFCLASS64) {
+        ok = parseElf<Elf64_Ehdr, Elf64_Phdr, Elf64_Dyn>(fd, info);
+    } else if (ident[EI_CLASS] == ELFCLASS32) {
+        ok = parseElf<Elf32_Ehdr, Elf32_Phdr, Elf32_Dyn>(fd, info);
+    }
+    if (!ok) return;
+    if (!info.interp.empty()) resolve(info.interp, kMaxScriptDepth, out);
+    const std::string origin = path.find('/') != std::string::npos ? path.substr(0, path.rfind('/')) : ".";
+    std::vector<std::string> rpath = splitSearchPath(info.rpath, origin);
+    std::vector<std::string> runpath = splitSearchPath(info.runpath, origin);
+    for (const std::string& name : info.needed) {
+        std::string library = findLibrary(name, origin, rpath, runpath, ident[EI_CLASS], info.machine);
+        if (!library.empty()) resolve(library, kMaxScriptDepth, out);
+    }
+}
+
+// Adds path and whatever it needs at exec to out: the interpreter of a "#!" script (followed at most
+// kMaxScriptDepth deep), the loader and libraries of an ELF file
+void ExecPrefetch::resolve(const std::string& link, int depth, std::vector<std::string>& out) {
+    if (depth > kMaxScriptDepth || out.size() >= kMaxFiles) return;
+    // One entry per file, whichever symlink led to it (e.g. /lib64/ld-linux-x86-64.so.2 and the name libc
+    // asks for). Relative names in DT_NEEDED or RPATH are taken relative to the watchdog's directory
+    char* real = realpath(link.c_str(), nullptr);
+    if (real == nullptr) return;
+    const std::string path = real;
+    std::free(real);
+    if (std::find(out.begin(), out.end(), path) != out.end()) return;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    out.push_back(path);
+    char head[256];
+    ssize_t n = pread(fd, head, sizeof(head) - 1, 0);
+    if (n >= SELFMAG && std::memcmp(head, ELFMAG, SELFMAG) == 0) {
+        resolveElf(path, fd, out);
+    } else if (n > 2 && head[0] == '#' && head[1] == '!') {
+        head[n] = '\0';
+        const char* start = head + 2 + std::strspn(head + 2, " \t");
+        std::string interpreter(start, std::strcspn(start, " \t\r\n"));
+        if (!interpreter.empty()) resolve(interpreter, depth + 1, out);
+    }
+    close(fd);
+}
+
+void ExecPrefetch::addService(const std::string& service, const std::string& exe) {
+    if (!dirsLoaded) loadLibraryDirs();
+    std::vector<std::string>& out = services[service];
+    out.clear();
+    std::string program = findProgram(exe);
+    if (!program.empty()) resolve(program, 0, out);
+}
+
+const std::vector<std::string>& ExecPrefetch::files(const std::string& service) const {
+    static const std::vector<std::string> none;
+    auto it = services.find(service);
+    return it != services.end() ? it->second : none;
+}
+
+void ExecPrefetch::prefetch(const std::string& service) const {
+    for (const std::string& file : files(service)) {
+        int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+}
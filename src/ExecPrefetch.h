@@ -0,0 +1,35 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Files an entry's processes load at exec, resolved once per config load ("readahead"), so they can be
+// pulled into the page cache before a restart instead of being faulted in page by page while the new
+// process starts. Under memory pressure the executable and its shared libraries are often evicted
+// while the service runs, and a restart then stalls on disk reads.
+class ExecPrefetch {
+public:
+    ExecPrefetch() = default;
+
+    // Resolves the executable of a service (searched in PATH like execvp), the interpreter of a script,
+    // and for ELF files the program interpreter and all DT_NEEDED libraries, recursively, the way the
+    // dynamic loader searches for them (RPATH, LD_LIBRARY_PATH, RUNPATH, ld.so.conf, default dirs)
+    void addService(const std::string& service, const std::string& exe);
+    void clear() { services.clear(); }
+    bool hasService(const std::string& service) const { return services.count(service) > 0; }
+    const std::vector<std::string>& files(const std::string& service) const;
+
+    // Starts reading the service's files into the page cache (posix_fadvise WILLNEED) and returns right
+    // away; the reads complete in the background
+    void prefetch(const std::string& service) const;
+private:
+    void resolve(const std::string& link, int depth, std::vector<std::string>& out);
+    void resolveElf(const std::string& path, int fd, std::vector<std::string>& out);
+    std::string findLibrary(const std::string& name, const std::string& origin, const std::vector<std::string>& rpath,
+                            const std::vector<std::string>& runpath, unsigned char elfClass, unsigned machine) const;
+    void loadLibraryDirs();
+
+    std::unordered_map<std::string, std::vector<std::string>> services;
+    std::vector<std::string> libraryDirs; // ld.so.conf and the default dirs, read at the first addService
+    bool dirsLoaded = false;
+};
@@ -0,0 +1,379 @@
+/*
+    LaunchHelper.cpp - Pre-forked process that starts services for the watchdog ("launch_helper")
+
+    Why a helper process?
+    ---------------------
+    Plain entries are started with posix_spawn, which shares the watchdog's memory with the child until
+    exec (vfork semantics), so their launch cost does not depend on the watchdog's size. Cgroup entries
+    need clone3 into their cgroup, a real fork: every mapping and page table of the watchdog (process
+    snapshot, compiled matcher, scan buffers, io_uring rings) is duplicated before the child can exec,
+    so the cost grows with the watchdog. The helper is forked once, when the watchdog starts (before its
+    first /proc scan), while it is small, and does those forks itself, so restarting a cgroup entry costs
+    the same after weeks of uptime as it did at boot. Going through the helper adds a round trip and a
+    second fork of its own, which is why plain entries keep using posix_spawn.
+
+    Protocol (SOCK_SEQPACKET socketpair, one message per request and per reply):
+    - request: LaunchRequest header, then the argv block of the entry ("exe\0arg1\0..."), with the
+      cgroup directory fd and the output fd, as far as the request has them, attached with SCM_RIGHTS
+    - reply: LaunchReply with the PID, or the errno of the failed launch and whether it happened in
+      the service (exec) or before it existed (clone3); the pidfd is attached with SCM_RIGHTS
+
+    The helper forks an intermediate per request, which clones the service, waits for its exec through
+    a close-on-exec pipe and exits right after replying. The orphaned service is reparented to the
+    nearest child subreaper, the watchdog, so its exit status and resource usage reach the watchdog's
+    wait4 loop like those of any other child.
+    Everything after fork() runs in a copy of a possibly multi-threaded process, so the helper only uses
+    system calls and static buffers: no malloc, no iostreams, no logging.
+*/
+
+#include "LaunchHelper.h"
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include "Logger.h"
+
+// Largest request the helper accepts: header plus the argv block of one entry
+static const size_t kMaxRequest = 64 * 1024;
+static const size_t kMaxArgs = 4096;
+// How long to wait for a reply before giving up on the helper
+static const int kReplyTimeoutMs = 2000;
+
+// Fds attached to a request, in this order
+enum RequestFds : uint32_t {
+    kCgroupFd = 1, // clone into this cgroup directory
+    kOutputFd = 2  // stdout and stderr of the service
+};
+
+struct LaunchRequest {
+    uint32_t argc; // words in the block, including argv[0]
+    uint32_t size; // bytes in the block that follows
+    uint32_t fds;  // RequestFds attached
+};
+
+struct LaunchReply {
+    int32_t pid;     // -1 on failure
+    int32_t error;   // errno of the failure
+    int32_t inChild; // 1 if the service was created but its exec failed
+};
+
+// Control message buffer for up to two fds, aligned as cmsghdr requires
+union FdControl {
+    cmsghdr align;
+    char buf[CMSG_SPACE(2 * sizeof(int))];
+};
+
+void closeFdsExcept(int keep, int from) {
+    unsigned first = static_cast<unsigned>(from);
+    unsigned k = static_cast<unsigned>(keep);
+    if (keep > from) syscall(SYS_close_range, first, k - 1, 0u);
+    syscall(SYS_close_range, keep < from ? first : k + 1, ~0u, 0u);
+}
+
+int setupChild(const ChildSetup& setup, int keepFd) {
+    if (setup.outputFd >= 0) {
+        dup2(setup.outputFd, STDOUT_FILENO);
+        dup2(setup.outputFd, STDERR_FILENO);
+    }
+    const size_t count = setup.listenCount + (setup.standbyFd >= 0 ? 1 : 0); // fds to put at 3, 4, ...
+    const int end = 3 + static_cast<int>(count);                          // first fd after them
+    if (count > 0) {
+        // Move whatever is still needed above the slots, then put the passed fds in place
+        if (keepFd >= 0 && keepFd < end && (keepFd = fcntl(keepFd, F_DUPFD_CLOEXEC, end)) < 0) return -1;
+        int moved[kMaxListenFds + 1];
+        for (size_t i = 0; i < count; ++i) {
+            int fd = i < setup.listenCount ? setup.listenFds[i] : setup.standbyFd;
+            moved[i] = fd >= end ? fd : fcntl(fd, F_DUPFD_CLOEXEC, end);
+            if (moved[i] < 0) return -1;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (dup2(moved[i], 3 + static_cast<int>(i)) < 0) return -1;
+        }
+    }
+    if (setup.listenPid != nullptr) {
+        // LISTEN_PID tells the program the sockets are meant for it and not for a child it forks
+        char digits[16];
+        int n = 0;
+        for (pid_t pid = getpid(); pid > 0; pid /= 10) digits[n++] = static_cast<char>('0' + pid % 10);
+        for (int i = 0; i < n; ++i) setup.listenPid[i] = digits[n - 1 - i];
+        setup.listenPid[n] = '\0';
+    }
+    closeFdsExcept(keepFd, end);
+    return keepFd;
+}
+
+void execChild(char* const* argv, const ChildSetup& setup) {
+    if (setup.envp != nullptr) {
+        execvpe(argv[0], argv, setup.envp);
+    } else {
+        execvp(argv[0], argv);
+    }
+}
+
+void childFailed(int execPipe) {
+    int error = errno;
+    ssize_t ignored = write(execPipe, &error, sizeof(error));
+    (void)ignored;
+    _exit(127);
+}
+
+int waitForExec(pid_t child, int execPipe[2]) {
+    close(execPipe[1]);
+    int error = 0;
+    ssize_t length;
+    do {
+        length = read(execPipe[0], &error, sizeof(error));
+    } while (length < 0 && errno == EINTR);
+    close(execPipe[0]);
+    if (length != static_cast<ssize_t>(sizeof(error))) return 0; // closed by exec
+    while (waitpid(child, nullptr, 0) < 0 && errno == EINTR) {}
+    return error != 0 ? error : ECHILD;
+}
+
+// Helper: Attach the fds that are not -1 to msg as SCM_RIGHTS, in order (at most two)
+static void attachFds(msghdr& msg, FdControl& control, int first, int second = -1) {
+    int fds[2];
+    size_t count = 0;
+    if (first >= 0) fds[count++] = first;
+    if (second >= 0) fds[count++] = second;
+    if (count == 0) return;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(count * sizeof(int));
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+}
+
+// Helper: Store the fds passed with a received message in fds (at most max, the rest is closed).
+// Returns how many were stored
+static size_t receivedFds(msghdr& msg, int* fds, size_t max) {
+    size_t count = 0;
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < n; ++i) {
+            int fd;
+            std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (count < max) fds[count++] = fd; else close(fd);
+        }
+    }
+    return count;
+}
+
+// Helper: Send a reply from the helper side, with the pidfd attached if there is one
+static bool sendReply(int sock, pid_t pid, int error, bool inChild, int pidfd) {
+    LaunchReply reply = { pid, error, inChild ? 1 : 0 };
+    iovec iov = { &reply, sizeof(reply) };
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    FdControl control;
+    attachFds(msg, control, pidfd);
+    return sendmsg(sock, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(reply));
+}
+
+// Helper: Point argv at the words of a request. Returns 0 or the errno to reply with
+static int parseRequest(char* request, ssize_t length, int flags, char** argv, uint32_t& fds) {
+    if (flags & MSG_TRUNC) return EMSGSIZE;
+    LaunchRequest header;
+    if (length < static_cast<ssize_t>(sizeof(header))) return EINVAL;
+    std::memcpy(&header, request, sizeof(header));
+    if (header.argc == 0 || header.argc > kMaxArgs || header.size != length - sizeof(header) ||
+        header.size == 0 || request[length - 1] != '\0') {
+        return EINVAL;
+    }
+    char* word = request + sizeof(header);
+    char* end = request + length;
+    for (uint32_t i = 0; i < header.argc; ++i) {
+        if (word >= end) return EINVAL;
+        argv[i] = word;
+        word += std::strlen(word) + 1;
+    }
+    argv[header.argc] = nullptr;
+    fds = header.fds;
+    return 0;
+}
+
+// Runs in the intermediate process: clones the service, waits until it has exec'd, replies with its PID
+// and pidfd (or the exec error), and exits, which hands the service over to the watchdog (the subreaper)
+[[noreturn]] static void launchService(int sock, char** argv, int cgroupFd, int outputFd,
+                                       const sigset_t& childMask) {
+    int execPipe[2];
+    if (pipe2(execPipe, O_CLOEXEC) < 0) _exit(sendReply(sock, -1, errno, false, -1) ? 0 : 1);
+    int pidfd = -1;
+    CloneArgs args;
+    std::memset(&args, 0, sizeof(args));
+    args.flags = CLONE_PIDFD | (cgroupFd >= 0 ? CLONE_INTO_CGROUP : 0);
+    args.pidfd = reinterpret_cast<uint64_t>(&pidfd);
+    args.exitSignal = SIGCHLD;
+    args.cgroup = cgroupFd >= 0 ? static_cast<uint64_t>(cgroupFd) : 0;
+    long child = syscall(SYS_clone3, &args, sizeof(args));
+    if (child == 0) {
+        sigprocmask(SIG_SETMASK, &childMask, nullptr);
+        ChildSetup setup;
+        setup.outputFd = outputFd;
+        setupChild(setup, execPipe[1]);
+        execChild(argv, setup);
+        childFailed(execPipe[1]);
+    }
+    bool sent;
+    if (child < 0) {
+        sent = sendReply(sock, -1, errno, false, -1);
+    } else {
+        int error = waitForExec(static_cast<pid_t>(child), execPipe);
+        sent = error == 0 ? sendReply(sock, static_cast<pid_t>(child), 0, false, pidfd)
+                          : sendReply(sock, -1, error, true, -1);
+    }
+    _exit(sent ? 0 : 1);
+}
+
+// The helper process: serves requests until the watchdog closes its end of the socket
+[[noreturn]] static void helperMain(int sock, const sigset_t& childMask) {
+    static char request[kMaxRequest];
+    static char* argv[kMaxArgs + 1];
+    while (true) {
+        iovec iov = { request, sizeof(request) };
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        FdControl control;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        ssize_t length = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        if (length < 0 && errno == EINTR) continue;
+        if (length <= 0) _exit(0); // the watchdog closed its end or is gone
+
+        int received[2] = { -1, -1 };
+        size_t count = receivedFds(msg, received, 2);
+        uint32_t fds = 0;
+        int error = parseRequest(request, length, msg.msg_flags, argv, fds);
+        int cgroupFd = -1;
+        int outputFd = -1;
+        if (error == 0) {
+            size_t next = 0;
+            if (fds & kCgroupFd) cgroupFd = next < count ? received[next++] : -1;
+            if (fds & kOutputFd) outputFd = next < count ? received[next++] : -1;
+            if (next != count || ((fds & kCgroupFd) && cgroupFd < 0) || ((fds & kOutputFd) && outputFd < 0)) {
+                error = EINVAL;
+            }
+        }
+        if (error == 0) {
+            pid_t intermediate = fork();
+            if (intermediate == 0) launchService(sock, argv, cgroupFd, outputFd, childMask);
+            if (intermediate < 0) {
+                error = errno;
+            } else {
+                int status = 0;
+                while (waitpid(intermediate, &status, 0) < 0 && errno == EINTR) {}
+                // Exit status 0 means the intermediate has replied
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) error = EIO;
+            }
+        }
+        for (size_t i = 0; i < count; ++i) close(received[i]);
+        if (error != 0 && !sendReply(sock, -1, error, false, -1)) _exit(0);
+    }
+}
+
+bool LaunchHelper::start(const sigset_t& childMask) {
+    if (sock >= 0) return true;
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+        logToWindowsEventLog(std::string("Cannot create the launch helper socket: ") + std::strerror(errno),
+                             WDOG_LOG_WARNING);
+        return false;
+    }
+    pid_t parent = getpid();
+    pid_t child = fork();
+    if (child == 0) {
+        // Helper process: die with the watchdog, and keep no fd but its end of the socket
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        if (getppid() != parent) _exit(0);
+        closeFdsExcept(fds[1]);
+        helperMain(fds[1], childMask);
+    }
+    close(fds[1]);
+    if (child < 0) {
+        logToWindowsEventLog(std::string("Cannot fork the launch helper: ") + std::strerror(errno), WDOG_LOG_WARNING);
+        close(fds[0]);
+        return false;
+    }
+    sock = fds[0];
+    timeval timeout = { kReplyTimeoutMs / 1000, (kReplyTimeoutMs % 1000) * 1000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return true;
+}
+
+void LaunchHelper::stop() {
+    if (sock < 0) return;
+    close(sock);
+    sock = -1;
+}
+
+LaunchAttempt LaunchHelper::launch(const ProcessInfo& info, int cgroupFd, int outputFd) {
+    LaunchAttempt attempt;
+    if (sock < 0) {
+        attempt.error = EPIPE;
+        return attempt;
+    }
+    // The words of argv lie back to back in one block (see ProcessInfo), so the request is two iovecs
+    char* const* argv = info.getArgv();
+    size_t argc = info.getArgc();
+    const char* last = argv[argc - 1];
+    size_t size = static_cast<size_t>(last + std::strlen(last) + 1 - argv[0]);
+    if (argc > kMaxArgs || sizeof(LaunchRequest) + size > kMaxRequest) {
+        attempt.error = EMSGSIZE;
+        return attempt;
+    }
+    LaunchRequest header = { static_cast<uint32_t>(argc), static_cast<uint32_t>(size),
+                             (cgroupFd >= 0 ? kCgroupFd : 0u) | (outputFd >= 0 ? kOutputFd : 0u) };
+    iovec iov[2] = { { &header, sizeof(header) }, { argv[0], size } };
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    FdControl control;
+    attachFds(msg, control, cgroupFd, outputFd);
+
+    LaunchReply reply;
+    ssize_t length = -1;
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) >= 0) {
+        iovec replyIov = { &reply, sizeof(reply) };
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &replyIov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        do {
+            length = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        } while (length < 0 && errno == EINTR);
+    }
+    if (length != static_cast<ssize_t>(sizeof(reply))) {
+        // Dead, or too slow: a late reply would be taken for the answer to the next request
+        logToWindowsEventLog(std::string("Launch helper is not responding (") +
+                             (length < 0 ? std::strerror(errno) : "connection closed") + "), launching directly",
+                             WDOG_LOG_WARNING);
+        stop();
+        attempt.error = EPIPE;
+        return attempt;
+    }
+    int pidfd = -1;
+    receivedFds(msg, &pidfd, 1);
+    if (reply.pid <= 0) {
+        if (pidfd >= 0) close(pidfd);
+        attempt.error = reply.error;
+        attempt.inChild = reply.inChild != 0;
+        return attempt;
+    }
+    attempt.pid = reply.pid;
+    attempt.pidfd = pidfd;
+    return attempt;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "ProcessInfo.h"
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <cstdint>
+
+// Launch primitives shared by LinuxApiWrapper and the launch helper, spelled out so the build does not
+// depend on kernel headers from 5.7 or later
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434
+#endif
+#ifndef SYS_close_range
+#define SYS_close_range 436
+#endif
+#ifndef SYS_clone3
+#define SYS_clone3 435
+#endif
+#ifndef CLONE_PIDFD
+#define CLONE_PIDFD 0x00001000
+#endif
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+
+// struct clone_args up to the cgroup field (CLONE_ARGS_SIZE_VER2)
+struct CloneArgs {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t childTid;
+    uint64_t parentTid;
+    uint64_t exitSignal;
+    uint64_t stack;
+    uint64_t stackSize;
+    uint64_t tls;
+    uint64_t setTid;
+    uint64_t setTidSize;
+    uint64_t cgroup;
+};
+
+// Result of one launch attempt
+struct LaunchAttempt {
+    pid_t pid = -1;       // the started process, -1 if the launch failed
+    int pidfd = -1;       // its pidfd, if the launcher got one
+    int error = 0;        // errno of the failure
+    bool inChild = false; // the process was created but failed before or in exec; it is reaped already
+};
+
+// Most sockets passed to one service (socket activation)
+static const size_t kMaxListenFds = 64;
+
+// What a forked child sets up between fork and exec, besides its signal mask
+struct ChildSetup {
+    int outputFd = -1;              // becomes stdout and stderr (captured output), unless -1
+    const int* listenFds = nullptr; // become fds 3, 4, ... in this order (socket activation)
+    size_t listenCount = 0;
+    int standbyFd = -1;             // becomes the fd after them (hot standby promotion), unless -1
+    char* const* envp = nullptr;    // environment to exec with; nullptr keeps the watchdog's
+    char* listenPid = nullptr;      // value of LISTEN_PID inside envp, set to the child's PID
+};
+
+// Closes every fd from `from` upwards except keep (-1: none). Best effort (close_range, Linux 5.9+):
+// the watchdog's own fds are O_CLOEXEC anyway
+void closeFdsExcept(int keep, int from = 3);
+
+// Child side of a launch, between fork and exec (async-signal-safe). setupChild() applies setup and
+// closes every other fd above stderr except keepFd, which is moved out of the way of the passed sockets
+// if needed; it returns the keepFd to use from then on, or -1 with errno set. execChild() replaces the
+// child with argv[0] and returns only if that failed
+int setupChild(const ChildSetup& setup, int keepFd);
+void execChild(char* const* argv, const ChildSetup& setup);
+
+// Exec handshake over a pipe2(O_CLOEXEC) pipe, so the parent learns synchronously whether a forked
+// child reached exec, and why not. childFailed() is the child side: it sends errno through the pipe and
+// exits (async-signal-safe). waitForExec() is the parent side: it closes the write end and reads until
+// a successful exec closes the pipe. Returns 0 on success, otherwise the child's errno; the failed
+// child is reaped then
+[[noreturn]] void childFailed(int execPipe);
+int waitForExec(pid_t child, int execPipe[2]);
+
+// Optional pre-forked launcher ("launch_helper"). The helper is forked once, when the watchdog starts and
+// is still small, and then starts cgroup entries on its behalf: the cost of the fork behind clone3 grows with the
+// size of the forking process (page tables, VMAs), so launching from the tiny helper keeps restart latency
+// flat however much memory the watchdog's snapshot, matcher and caches take.
+//
+// Requests go over a SOCK_SEQPACKET socketpair: the argv block of the entry, with the cgroup directory fd
+// and the fd for its stdout and stderr (SCM_RIGHTS). The helper forks a short-lived intermediate, which clones the
+// service (clone3 with CLONE_PIDFD, and CLONE_INTO_CGROUP when a cgroup fd came along), sends back
+// its PID and pidfd, and exits. The service is then reparented to the watchdog, which is made a child
+// subreaper, so exits are reaped and reported by the watchdog exactly like those of its own children.
+class LaunchHelper {
+public:
+    LaunchHelper() = default;
+    ~LaunchHelper() { stop(); }
+    LaunchHelper(const LaunchHelper&) = delete;
+    LaunchHelper& operator=(const LaunchHelper&) = delete;
+
+    // Forks the helper; services it starts get childMask as their signal mask. Returns false if the
+    // helper could not be created
+    bool start(const sigset_t& childMask);
+    // Closes the connection; the helper exits and is reaped by the watchdog's SIGCHLD handling
+    void stop();
+    bool isRunning() const { return sock >= 0; }
+
+    // Starts the entry through the helper, inside the cgroup of cgroupFd and with outputFd as stdout and
+    // stderr, unless they are -1. A failed attempt carries EMSGSIZE if the arguments are too large for
+    // one request, EPIPE if the helper is gone (it is stopped then), the error of clone3 in the helper
+    // (ENOSYS, E2BIG or EINVAL: no clone3 into cgroups on this kernel), or the exec error of the service
+    LaunchAttempt launch(const ProcessInfo& info, int cgroupFd, int outputFd);
+private:
+    int sock = -1; // our end of the socketpair
+};
@@ -1,65 +1,1030 @@
 #include "LinuxApiWrapper.h"
+#include "ConfigManager.h"
 #include <sys/types.h>
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
 #include <cstdio>
 #include <cstring>
+#include <cerrno>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <vector>
 #include <algorithm>
-#include <filesystem>
+#include "Logger.h"
 
-// Helper: Get all PIDs for a process name by scanning /proc and matching the process name in /proc/[pid]/comm
-static std::vector<pid_t> getPidsByName(const std::string& name) {
+// Full /proc scans are only needed to reconcile the snapshot with processes we did not start
+// ourselves; exits of our own children are reported immediately through their pidfds
+static const std::chrono::milliseconds kReconcileInterval(2000);
+
+// Longest name /proc/[pid]/comm can hold; longer names are cut off at this length
+static const size_t kCommMaxLen = sizeof(ProcEntry::comm) - 1;
+
+// Upper bound for exits nobody has collected through takeExitedProcesses() yet
+static const size_t kMaxPendingExits = 1024;
+
+// What an epoll registration refers to; stored in the upper half of epoll_event.data.u64,
+// with a source-specific value (fd or PID) in the lower half
+enum EventSource : uint32_t {
+    kChildPidfd = 1,    // value: PID of the child
+    kChildSignal = 2,   // SIGCHLD signalfd
+    kProcConnector = 3,
+    kCgroupEvents = 4,  // inotify on the cgroup.events files of cgroup entries
+    kServiceOutput = 5, // value: read end of a captured output pipe
+    kNotifySocket = 6,  // fd store messages of services
+    kStoppingPidfd = 7  // value: PID of a process being stopped that is not a tracked child
+};
+
+// Helper: pidfd_open(2) has no glibc wrapper on older distributions
+static int pidfdOpen(pid_t pid) {
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+// Helper: Neither has pidfd_send_signal(2) (Linux 5.1+)
+#ifndef SYS_pidfd_send_signal
+#define SYS_pidfd_send_signal 424
+#endif
+static int pidfdSendSignal(int pidfd, int sig) {
+    return static_cast<int>(syscall(SYS_pidfd_send_signal, pidfd, sig, nullptr, 0u));
+}
+
+// Helper: The comm a freshly started executable will have (its file name)
+static std::string commOf(const std::string& exe) {
+    size_t slash = exe.rfind('/');
+    return slash == std::string::npos ? exe : exe.substr(slash + 1);
+}
+
+// Get all PIDs for a process name with a fresh /proc scan (used for queries made outside a monitor tick).
+// The name of a config entry is matched the way the entry says (exact, glob or regex). A comm that may
+// have been truncated is only resolved to the full executable name when the query could match it.
+std::vector<pid_t> LinuxApiWrapper::getPidsByName(const std::string& name) {
     std::vector<pid_t> pids;
-    // Iterate over all directories in /proc
-    for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
-        if (!entry.is_directory()) continue;
-        std::string pidStr = entry.path().filename();
-        // Only consider directories with numeric names (PIDs)
-        if (!std::all_of(pidStr.begin(), pidStr.end(), ::isdigit)) continue;
-        std::ifstream cmdline(entry.path() / "comm");
-        std::string procName;
-        // Read the process name from /proc/[pid]/comm
-        if (cmdline >> procName) {
-            if (procName == name) {
-                pids.push_back(std::stoi(pidStr));
-            }
+    int rule = matcher.findRule(name);
+    std::string longName;
+    scanner.scan(scanBuffer);
+    for (const ProcEntry& e : scanBuffer) {
+        const char* procName = e.comm;
+        if (std::strlen(e.comm) == kCommMaxLen &&
+            (rule >= 0 ? matcher.mayMatchLonger(e.comm)
+                       : name.size() > kCommMaxLen && name.compare(0, kCommMaxLen, e.comm) == 0) &&
+            scanner.readLongName(e.pid, e.comm, longName)) {
+            procName = longName.c_str();
+        }
+        if (rule < 0) {
+            if (name == procName) pids.push_back(e.pid);
+            continue;
+        }
+        matchHits.clear();
+        matcher.match(procName, matchHits);
+        if (std::find(matchHits.begin(), matchHits.end(), static_cast<size_t>(rule)) != matchHits.end()) {
+            pids.push_back(e.pid);
         }
     }
     return pids;
 }
 
-// Returns true if any process with the given name is running
+// PIDs the snapshot lists for a config entry, or for a plain comm if the name is not a config entry
+std::vector<pid_t> LinuxApiWrapper::snapshotPids(const std::string& name) const {
+    int rule = matcher.findRule(name);
+    if (rule >= 0) return rulePids[rule];
+    auto it = snapshot.find(name);
+    return it == snapshot.end() ? std::vector<pid_t>() : it->second;
+}
+
+// Read the name of a single process from /proc/[pid]/comm
+bool LinuxApiWrapper::readComm(pid_t pid, std::string& name) {
+    char comm[16];
+    if (!scanner.readComm(pid, comm)) return false;
+    name.assign(comm);
+    return true;
+}
+
+// Must be constructed before the program starts any thread: SIGCHLD is blocked here so that it is only
+// ever delivered through the signalfd, which requires every thread to have it blocked
+LinuxApiWrapper::LinuxApiWrapper(DiscoveryBackend backend, bool launchHelper) {
+    sigemptyset(&childMask);
+    sigaddset(&childMask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &childMask, &originalMask);
+    // Fork the helper while the watchdog is as small as it gets: before the snapshot and the rest exist
+    configureLaunchHelper(launchHelper);
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        logToWindowsEventLog(std::string("epoll_create1 failed: ") + std::strerror(errno), WDOG_LOG_WARNING);
+    }
+    // Children start with the original mask; everything above stderr that we inherited without
+    // O_CLOEXEC is closed in them (close_range, glibc 2.34+)
+    posix_spawnattr_init(&spawnAttr);
+    posix_spawnattr_setsigmask(&spawnAttr, &originalMask);
+    posix_spawnattr_setflags(&spawnAttr, POSIX_SPAWN_SETSIGMASK);
+    posix_spawn_file_actions_init(&spawnActions);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+    posix_spawn_file_actions_addclosefrom_np(&spawnActions, 3);
+#endif
+    signalFd = signalfd(-1, &childMask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd < 0) {
+        logToWindowsEventLog(std::string("signalfd failed: ") + std::strerror(errno), WDOG_LOG_WARNING);
+    } else {
+        watchFd(signalFd, kChildSignal, 0);
+    }
+    if (backend == DiscoveryBackend::ProcConnector) {
+        // Subscribe before the initial scan, so no process event falls between the two
+        if (!connector.open()) {
+            logToWindowsEventLog(std::string("Proc connector unavailable (") + std::strerror(errno) +
+                                 "), falling back to /proc scanning", WDOG_LOG_WARNING);
+        } else {
+            watchFd(connector.fd(), kProcConnector, 0);
+            rescanProcessTable();
+        }
+    }
+}
+
+LinuxApiWrapper::~LinuxApiWrapper() {
+    for (const auto& c : children) {
+        if (c.second.pidfd >= 0) close(c.second.pidfd);
+    }
+    for (const auto& s : stopping) {
+        if (s.second.ownPidfd) close(s.second.pidfd);
+    }
+    if (signalFd >= 0) close(signalFd);
+    if (epollFd >= 0) close(epollFd);
+    posix_spawn_file_actions_destroy(&spawnActions);
+    posix_spawnattr_destroy(&spawnAttr);
+    pthread_sigmask(SIG_SETMASK, &originalMask, nullptr);
+}
+
+// Registers fd for readability with the epoll instance, tagged with its source
+void LinuxApiWrapper::watchFd(int fd, uint32_t source, uint32_t value) {
+    if (epollFd < 0) return;
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = (static_cast<uint64_t>(source) << 32) | value;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        logToWindowsEventLog(std::string("epoll_ctl failed: ") + std::strerror(errno), WDOG_LOG_WARNING);
+    }
+}
+
+// Brings the snapshot up to date with an incremental /proc scan: only processes that appeared,
+// disappeared or were renamed since the previous scan touch the index. When the snapshot cannot be
+// trusted (first scan, or lost proc connector events) it is rebuilt from scratch
+void LinuxApiWrapper::rescanProcessTable() {
+    if (!snapshotValid) {
+        snapshot.clear();
+        records.clear();
+        for (auto& pids : rulePids) pids.clear();
+        scanner.clearCache();
+    }
+    lastScan = std::chrono::steady_clock::now();
+    if (!scanner.scanIncremental(scanDelta)) {
+        logToWindowsEventLog("Failed to scan /proc", WDOG_LOG_WARNING);
+        return;
+    }
+    for (pid_t pid : scanDelta.disappeared) {
+        forgetPid(pid);
+    }
+    for (const ProcEntry& e : scanDelta.appeared) {
+        indexPid(e.pid, e.comm);
+    }
+    snapshotValid = true;
+}
+
+// Records that pid now runs under the given name and classifies it against every config entry.
+// A name of exactly kCommMaxLen bytes may be a truncated comm; it is resolved to the full executable
+// name, but only if some config entry could match a longer name starting with it.
+// Idempotent, so events that overlap with a scan are harmless
+void LinuxApiWrapper::indexPid(pid_t pid, const std::string& name) {
+    std::string fullName = name;
+    if (name.size() == kCommMaxLen && matcher.mayMatchLonger(name)) {
+        scanner.readLongName(pid, name.c_str(), fullName);
+    }
+    auto it = records.find(pid);
+    if (it != records.end()) {
+        if (it->second.name == fullName) return;
+        forgetPid(pid);
+    }
+    ProcRecord& rec = records[pid];
+    rec.name = fullName;
+    snapshot[fullName].push_back(pid);
+    matchHits.clear();
+    matcher.match(fullName, matchHits);
+    rec.rules = matchHits;
+    for (size_t rule : rec.rules) {
+        rulePids[rule].push_back(pid);
+    }
+}
+
+// Removes a PID that is known to be gone from the snapshot. Returns true if it was the last process of
+// a config entry, i.e. the monitor should react right away
+bool LinuxApiWrapper::forgetPid(pid_t pid) {
+    auto it = records.find(pid);
+    if (it == records.end()) return false;
+    bool lastOfEntry = false;
+    auto entry = snapshot.find(it->second.name);
+    if (entry != snapshot.end()) {
+        auto& pids = entry->second;
+        pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+        if (pids.empty()) snapshot.erase(entry);
+    }
+    for (size_t rule : it->second.rules) {
+        auto& pids = rulePids[rule];
+        pids.erase(std::remove(pids.begin(), pids.end(), pid), pids.end());
+        if (pids.empty()) lastOfEntry = true;
+    }
+    records.erase(it);
+    return lastOfEntry;
+}
+
+// Creates a cgroup for every entry with "cgroup": true and drops the ones no longer configured.
+// Without a usable cgroup2 root those entries fall back to name matching
+void LinuxApiWrapper::configureCgroups(const ConfigManager& cfg) {
+    std::vector<std::string> wanted;
+    for (const auto& p : cfg.getProcesses()) {
+        if (p.usesCgroup()) wanted.push_back(p.getName());
+    }
+    for (const auto& name : cgroups.serviceNames()) {
+        if (std::find(wanted.begin(), wanted.end(), name) == wanted.end()) cgroups.removeService(name);
+    }
+    if (wanted.empty()) return;
+    if (!cgroups.init(cfg.getSettings().cgroupRoot)) {
+        watchedCgroupFd = -1; // init closed whatever was watched
+        logToWindowsEventLog("cgroup entries fall back to process name matching", WDOG_LOG_WARNING);
+        return;
+    }
+    // A new root comes with a new inotify fd, even if it reuses the number of the old one
+    if (cgroups.generation() != watchedCgroupGeneration) {
+        watchedCgroupFd = cgroups.eventFd();
+        watchedCgroupGeneration = cgroups.generation();
+        watchFd(watchedCgroupFd, kCgroupEvents, 0);
+    }
+    for (const auto& name : wanted) {
+        cgroups.addService(name);
+    }
+}
+
+// Starts or stops the launch helper. Services it launches are reparented to us when its intermediate
+// process exits, which requires being a child subreaper
+void LinuxApiWrapper::configureLaunchHelper(bool wanted) {
+    if (wanted && !helper.isRunning()) {
+        if (prctl(PR_SET_CHILD_SUBREAPER, 1) < 0) {
+            logToWindowsEventLog(std::string("Cannot become a child subreaper, not using the launch helper: ") +
+                                 std::strerror(errno), WDOG_LOG_WARNING);
+            return;
+        }
+        helper.start(originalMask);
+    } else if (!wanted && helper.isRunning()) {
+        helper.stop();
+    }
+}
+
+// Gives every launchable entry a captured stdout/stderr when "log_dir" is set. Entries that are gone, or
+// all of them when capture is switched off, keep writing to their pipes until their processes exit
+void LinuxApiWrapper::configureOutputCapture(const ConfigManager& cfg) {
+    const WatchdogSettings& settings = cfg.getSettings();
+    std::vector<std::string> wanted;
+    if (!settings.logDir.empty() && output.init(settings.logDir, settings.logMaxBytes, settings.logTailBytes)) {
+        for (const auto& p : cfg.getProcesses()) {
+            if (!p.getExe().empty()) wanted.push_back(p.getName());
+        }
+    }
+    for (const auto& name : output.serviceNames()) {
+        if (std::find(wanted.begin(), wanted.end(), name) == wanted.end()) output.removeService(name);
+    }
+    for (const auto& name : wanted) {
+        if (output.hasService(name) || !output.addService(name)) continue;
+        int fd = output.pipeFd(name);
+        watchFd(fd, kServiceOutput, static_cast<uint32_t>(fd));
+    }
+}
+
+// Opens the listening sockets of every launchable entry that has "listen", keeping those that are open
+// already, sizes the fd stores of entries with "fd_store", prepares the environment of entries with
+// "standby", and drops all of it for entries that need none
+void LinuxApiWrapper::configureListenSockets(const ConfigManager& cfg) {
+    std::vector<std::string> wanted;
+    for (const auto& p : cfg.getProcesses()) {
+        if (p.getExe().empty() || (p.getListen().empty() && p.getFdStore() == 0 && p.getStandby() == 0)) continue;
+        size_t storeLimit = p.getFdStore();
+        if (storeLimit > 0 && !notify.isOpen()) {
+            if (notify.open()) {
+                watchFd(notify.fd(), kNotifySocket, 0);
+            } else {
+                logToWindowsEventLog(std::string("Cannot open the fd store socket: ") + std::strerror(errno),
+                                     WDOG_LOG_WARNING);
+            }
+        }
+        if (!notify.isOpen()) storeLimit = 0;
+        wanted.push_back(p.getName());
+        sockets.configure(p.getName(), p.getListen(), storeLimit, notify.address(), p.getStandby() > 0);
+    }
+    for (const auto& name : sockets.serviceNames()) {
+        if (std::find(wanted.begin(), wanted.end(), name) == wanted.end()) sockets.removeService(name);
+    }
+}
+
+// Config entry a process belongs to: the one it was started for, or the cgroup entry it runs in.
+// Empty if neither
+std::string LinuxApiWrapper::serviceOfPid(pid_t pid) const {
+    auto child = children.find(pid);
+    if (child != children.end()) return child->second.service;
+    for (const auto& name : cgroups.serviceNames()) {
+        std::vector<pid_t> pids = cgroups.members(name);
+        if (std::find(pids.begin(), pids.end(), pid) != pids.end()) return name;
+    }
+    return std::string();
+}
+
+// Hands the fds services sent to the notify socket to their fd stores, or closes them if the sender
+// belongs to no entry with an fd store
+void LinuxApiWrapper::receiveStoredFds() {
+    std::vector<NotifySocket::Message> messages;
+    notify.receive(messages);
+    for (auto& message : messages) {
+        std::string service = serviceOfPid(message.pid);
+        if (service.empty() || !sockets.storesFds(service)) {
+            if (!message.fds.empty()) {
+                logToWindowsEventLog("Ignoring fds sent by PID " + std::to_string(message.pid) +
+                                     ", which belongs to no entry with an fd_store", WDOG_LOG_WARNING);
+            }
+            for (int fd : message.fds) close(fd);
+            continue;
+        }
+        if (message.remove) sockets.removeStored(service, message.fdName);
+        for (int fd : message.fds) {
+            if (message.store) {
+                sockets.storeFd(service, message.fdName, fd);
+            } else {
+                close(fd);
+            }
+        }
+    }
+}
+
+// Applies the scan settings (a new proc root rebuilds the snapshot), prepares the launch spec of every
+// entry, then takes the matcher compiled at config load and reclassifies every known process against
+// it. Truncated names the new entries could match are resolved in full
+void LinuxApiWrapper::configure(const ConfigManager& cfg) {
+    const WatchdogSettings& settings = cfg.getSettings();
+    scanner.setThreads(settings.scanThreads);
+    scanner.setBatchedReads(settings.ioUring);
+    if (settings.procRoot != scanner.getRoot()) {
+        if (!scanner.setRoot(settings.procRoot)) {
+            logToWindowsEventLog("Cannot open proc root " + settings.procRoot + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        }
+        // Connector events carry PIDs of our own namespace, which another procfs need not list
+        if (connector.isOpen() && settings.procRoot != "/proc") {
+            logToWindowsEventLog("Proc connector disabled for proc root " + settings.procRoot + ", falling back to scanning",
+                                 WDOG_LOG_WARNING);
+            connector.close();
+        }
+        snapshotValid = false;
+    }
+    stopGrace = std::chrono::milliseconds(settings.stopGraceMs);
+    configureLaunchHelper(settings.launchHelper);
+    configureCgroups(cfg);
+    configureOutputCapture(cfg);
+    configureListenSockets(cfg);
+    configureStandbys(cfg);
+    launchSpecs.clear();
+    prefetcher.clear();
+    for (const auto& p : cfg.getProcesses()) {
+        if (p.getExe().empty()) continue;
+        launchSpecs[p.getName()] = p;
+        if (p.usesReadahead()) prefetcher.addService(p.getName(), p.getArgv()[0]);
+    }
+    matcher = cfg.getMatcher();
+    rulePids.assign(matcher.ruleCount(), std::vector<pid_t>());
+    std::vector<pid_t> truncated;
+    for (auto& entry : records) {
+        if (entry.second.name.size() == kCommMaxLen && matcher.mayMatchLonger(entry.second.name)) {
+            truncated.push_back(entry.first);
+        }
+        matchHits.clear();
+        matcher.match(entry.second.name, matchHits);
+        entry.second.rules = matchHits;
+        for (size_t rule : matchHits) {
+            rulePids[rule].push_back(entry.first);
+        }
+    }
+    for (pid_t pid : truncated) {
+        std::string comm = records[pid].name;
+        forgetPid(pid);
+        indexPid(pid, comm);
+    }
+}
+
+// Applies all pending proc connector events to the snapshot. Returns true if a config entry lost its
+// last process
+bool LinuxApiWrapper::applyConnectorEvents() {
+    connectorEvents.clear();
+    if (!connector.drain(connectorEvents)) {
+        // Events were lost; the index cannot be trusted until the next full scan
+        logToWindowsEventLog("Proc connector overflowed, resynchronising with a /proc scan", WDOG_LOG_WARNING);
+        snapshotValid = false;
+    }
+    bool wake = false;
+    std::string name;
+    for (const auto& ev : connectorEvents) {
+        switch (ev.type) {
+            case ProcConnector::Event::Fork: {
+                // A forked child keeps its parent's name until it execs or renames itself
+                auto parent = records.find(ev.parentPid);
+                if (parent != records.end()) {
+                    name = parent->second.name;
+                    indexPid(ev.pid, name);
+                } else if (readComm(ev.pid, name)) {
+                    indexPid(ev.pid, name);
+                }
+                break;
+            }
+            case ProcConnector::Event::Exec:
+                if (readComm(ev.pid, name)) indexPid(ev.pid, name);
+                break;
+            case ProcConnector::Event::Comm:
+                indexPid(ev.pid, ev.comm);
+                break;
+            case ProcConnector::Event::Exit:
+                wake = forgetPid(ev.pid) || wake;
+                break;
+        }
+    }
+    return wake;
+}
+
+// Makes the snapshot usable for the whole tick. With the proc connector the snapshot is always
+// current and /proc is only scanned again after lost events. Otherwise checking N monitored
+// processes costs at most one /proc scan, and none at all when the tick was triggered by a child
+// exit event shortly after the previous scan
+void LinuxApiWrapper::beginTick() {
+    if (connector.isOpen()) {
+        applyConnectorEvents();
+        if (!snapshotValid) rescanProcessTable();
+    } else if (!snapshotValid || std::chrono::steady_clock::now() - lastScan >= kReconcileInterval) {
+        rescanProcessTable();
+    }
+    inTick = true;
+}
+
+// Queries made outside a tick scan /proc directly again. Standby pools are refilled here, after the
+// monitor's starts, so a promotion or a fresh start gets its replacement standbys within the same tick
+void LinuxApiWrapper::endTick() {
+    inTick = false;
+    refillStandbys();
+}
+
+// Reaps every child that has exited with wait4, recording its exit status and resource usage, and
+// drops it from the snapshot so the monitor sees it as dead right away. This also collects children
+// we could not open a pidfd for, which would otherwise stay zombies and keep looking alive in /proc.
+// Returns true if anything was reaped
+bool LinuxApiWrapper::reapChildren() {
+    // A service that stores fds on its way out sent them before it exited. Take them while the sender is
+    // still a known child: once it is reaped its message could no longer be matched to its entry
+    receiveStoredFds();
+    bool reaped = false;
+    while (true) {
+        int status = 0;
+        rusage usage{};
+        pid_t pid = wait4(-1, &status, WNOHANG, &usage);
+        if (pid < 0 && errno == EINTR) continue;
+        if (pid <= 0) break; // 0: nothing else has exited, ECHILD: no children at all
+        reaped = true;
+
+        ProcessExit exit;
+        exit.pid = pid;
+        if (WIFEXITED(status)) {
+            exit.exitCode = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            exit.signal = WTERMSIG(status);
+        }
+        exit.userCpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+        exit.systemCpuSeconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        exit.maxRssKb = usage.ru_maxrss;
+
+        finishStop(pid);
+        // Orphans of our services are reparented to us when the launch helper made us a subreaper;
+        // they are reaped without being reported
+        auto it = children.find(pid);
+        if (it == children.end()) {
+            forgetPid(pid);
+            continue;
+        }
+        exit.name = it->second.name;
+        exit.service = it->second.service;
+        // Whatever it wrote is in its pipe already; a failure is reported with its last lines
+        if (output.hasService(exit.service)) {
+            output.drainService(exit.service);
+            if (exit.signal != 0 || exit.exitCode != 0) exit.output = output.tail(exit.service);
+        }
+        // A launch that died before joining its cgroup never produces a cgroup event
+        if (cgroups.hasService(exit.service)) cgroups.refresh(exit.service);
+        auto pool = standbys.find(exit.service);
+        if (pool != standbys.end()) standbyExited(exit.service, exit);
+        // Unless a standby took over, a restart follows: start reading its files during the restart delay
+        if (prefetcher.hasService(exit.service) && (pool == standbys.end() || pool->second.active < 0)) {
+            prefetcher.prefetch(exit.service);
+        }
+        if (it->second.pidfd >= 0) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.pidfd, nullptr);
+            close(it->second.pidfd);
+        }
+        children.erase(it);
+        forgetPid(pid);
+        if (exits.size() < kMaxPendingExits) {
+            exits.push_back(exit);
+        }
+    }
+    return reaped;
+}
+
+std::vector<ProcessExit> LinuxApiWrapper::takeExitedProcesses() {
+    std::vector<ProcessExit> taken;
+    taken.swap(exits);
+    return taken;
+}
+
+// Waits on the pidfds of all tracked children, on SIGCHLD and, if enabled, on the proc connector.
+// A child exit is noticed as soon as it happens, so the monitor is woken up right away instead of on
+// its next periodic tick. Connector events that do not empty a config entry are applied without waking it.
+bool LinuxApiWrapper::waitForEvents(int timeoutMs) {
+    if (epollFd < 0) {
+        return OSApiWrapper::waitForEvents(timeoutMs);
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    epoll_event events[32];
+    while (true) {
+        // Wake up for the next stop that is due as well, rounding up so the deadline has passed by then
+        expireStops();
+        auto wakeAt = deadline;
+        for (const auto& s : stopping) wakeAt = std::min(wakeAt, s.second.deadline);
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            wakeAt - std::chrono::steady_clock::now() + std::chrono::microseconds(999)).count();
+        if (remaining < 0) remaining = 0;
+        int n = epoll_wait(epollFd, events, 32, static_cast<int>(remaining));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logToWindowsEventLog(std::string("epoll_wait failed: ") + std::strerror(errno), WDOG_LOG_WARNING);
+            return false;
+        }
+        if (n == 0) {
+            if (std::chrono::steady_clock::now() < deadline) continue; // woken for a stop deadline
+            expireStops();
+            return false;
+        }
+        bool wake = false;
+        for (int i = 0; i < n; ++i) {
+            uint32_t source = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            switch (source) {
+                case kProcConnector:
+                    wake = applyConnectorEvents() || wake;
+                    break;
+                case kChildSignal: {
+                    // SIGCHLDs coalesce; drain them and reap whatever has exited
+                    signalfd_siginfo info;
+                    while (read(signalFd, &info, sizeof(info)) == sizeof(info)) {}
+                    wake = reapChildren() || wake;
+                    break;
+                }
+                case kChildPidfd:
+                    wake = reapChildren() || wake;
+                    break;
+                case kCgroupEvents: {
+                    std::vector<std::string> emptied;
+                    cgroups.handleEvents(emptied);
+                    wake = wake || !emptied.empty();
+                    break;
+                }
+                case kServiceOutput:
+                    output.drain(static_cast<int>(events[i].data.u64 & 0xffffffffu));
+                    break;
+                case kNotifySocket:
+                    receiveStoredFds();
+                    break;
+                case kStoppingPidfd:
+                    finishStop(static_cast<pid_t>(events[i].data.u64 & 0xffffffffu));
+                    break;
+            }
+        }
+        if (wake || !snapshotValid) return true;
+    }
+}
+
+// Returns true if any process with the given name (or matching the given config entry) is running.
+// For cgroup entries this is whether their cgroup contains any process
 bool LinuxApiWrapper::isProcessRunning(const std::string& name) {
+    if (cgroups.hasService(name)) {
+        return cgroups.isPopulated(name);
+    }
+    if (inTick) {
+        return !snapshotPids(name).empty();
+    }
     return !getPidsByName(name).empty();
 }
 
-// Starts a process with the given executable and arguments using fork and execlp
-void LinuxApiWrapper::startProcess(const std::string& exe, const std::string& args) {
+// Records a freshly started child: in the snapshot, so that later checks see it as running and do not
+// start it a second time before the next reconcile scan, and with a watched pidfd, so its exit is
+// noticed immediately. This cannot race with PID reuse: the child stays a zombie until we reap it.
+// Without pidfd support, SIGCHLD still reports the exit
+void LinuxApiWrapper::trackChild(pid_t pid, const std::string& exe, int pidfd, const std::string& service) {
+    if (snapshotValid) {
+        indexPid(pid, commOf(exe));
+    }
+    if (pidfd < 0) pidfd = pidfdOpen(pid);
+    if (pidfd >= 0) {
+        watchFd(pidfd, kChildPidfd, static_cast<uint32_t>(pid));
+    }
+    children[pid] = TrackedChild{ pidfd, exe, service };
+}
+
+// Launches a process with posix_spawnp. glibc implements it with clone(CLONE_VM | CLONE_VFORK), so
+// unlike fork() no page tables are copied however large the watchdog's tables are, and a failed exec
+// is reported here instead of in a child. With an outputFd, that becomes its stdout and stderr
+LaunchAttempt LinuxApiWrapper::spawn(const ProcessInfo& info, int outputFd, char* const* envp) {
+    char* const* argv = info.getArgv();
+    if (envp == nullptr) envp = environ;
+    LaunchAttempt attempt;
+    pid_t pid = -1;
+    int err;
+    if (outputFd < 0) {
+        err = posix_spawnp(&pid, argv[0], &spawnActions, &spawnAttr, argv, envp);
+    } else {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, outputFd, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, outputFd, STDERR_FILENO);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+        posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#endif
+        err = posix_spawnp(&pid, argv[0], &actions, &spawnAttr, argv, envp);
+        posix_spawn_file_actions_destroy(&actions);
+    }
+    if (err != 0) {
+        attempt.error = err;
+        attempt.inChild = true;
+        return attempt;
+    }
+    attempt.pid = pid;
+    return attempt;
+}
+
+// Creates the child with clone3(CLONE_PIDFD), directly inside a cgroup if cgroupFd is not -1
+// (CLONE_INTO_CGROUP, Linux 5.7+). The child never runs outside the cgroup, nothing has to be written
+// to cgroup.procs, and the pidfd comes from the same system call, so there is no window in which the
+// PID could be reused. Unlike posix_spawn, the child can run setup code of its own before exec (passed
+// sockets, LISTEN_PID). Returns once the child has exec'd, or with the reason it could not
+LaunchAttempt LinuxApiWrapper::cloneChild(const ProcessInfo& info, int cgroupFd, const ChildSetup& setup) {
+    char* const* argv = info.getArgv();
+    LaunchAttempt attempt;
+    int execPipe[2];
+    if (pipe2(execPipe, O_CLOEXEC) < 0) {
+        attempt.error = errno;
+        return attempt;
+    }
+    int pidfd = -1;
+    CloneArgs args;
+    std::memset(&args, 0, sizeof(args));
+    args.flags = CLONE_PIDFD | (cgroupFd >= 0 ? CLONE_INTO_CGROUP : 0);
+    args.pidfd = reinterpret_cast<uint64_t>(&pidfd);
+    args.exitSignal = SIGCHLD;
+    args.cgroup = cgroupFd >= 0 ? static_cast<uint64_t>(cgroupFd) : 0;
+    long pid = syscall(SYS_clone3, &args, sizeof(args));
+    if (pid == 0) {
+        // Child process: like after fork(), only async-signal-safe calls until exec
+        sigprocmask(SIG_SETMASK, &originalMask, nullptr);
+        int reportFd = setupChild(setup, execPipe[1]);
+        if (reportFd < 0) childFailed(execPipe[1]);
+        execChild(argv, setup);
+        childFailed(reportFd);
+    }
+    if (pid < 0) {
+        attempt.error = errno;
+        close(execPipe[0]);
+        close(execPipe[1]);
+        return attempt;
+    }
+    attempt.error = waitForExec(static_cast<pid_t>(pid), execPipe);
+    if (attempt.error != 0) {
+        if (pidfd >= 0) close(pidfd);
+        attempt.inChild = true;
+        return attempt;
+    }
+    attempt.pid = static_cast<pid_t>(pid);
+    attempt.pidfd = pidfd;
+    return attempt;
+}
+
+// Fallback for kernels without clone3 or CLONE_INTO_CGROUP: forks a child that moves itself into the
+// cgroup (through its open cgroup.procs file, unless cgroupProcsFd is -1) before exec.
+// Returns once the child has exec'd, or with the reason it could not
+LaunchAttempt LinuxApiWrapper::forkChild(const ProcessInfo& info, int cgroupProcsFd, const ChildSetup& setup) {
+    char* const* argv = info.getArgv();
+    LaunchAttempt attempt;
+    int execPipe[2];
+    if (pipe2(execPipe, O_CLOEXEC) < 0) {
+        attempt.error = errno;
+        return attempt;
+    }
     pid_t pid = fork();
     if (pid == 0) {
-        // Child process: execute the program
-        if (!args.empty()) {
-            execlp(exe.c_str(), exe.c_str(), args.c_str(), (char*)nullptr);
+        // Child process: undo the SIGCHLD blocking of the watchdog, then execute the program
+        sigprocmask(SIG_SETMASK, &originalMask, nullptr);
+        // Join the cgroup before exec, so the program and everything it forks is inside it
+        if (cgroupProcsFd >= 0 && write(cgroupProcsFd, "0", 1) != 1) childFailed(execPipe[1]);
+        int reportFd = setupChild(setup, execPipe[1]);
+        if (reportFd < 0) childFailed(execPipe[1]);
+        execChild(argv, setup);
+        childFailed(reportFd);
+    }
+    if (pid < 0) {
+        attempt.error = errno;
+        close(execPipe[0]);
+        close(execPipe[1]);
+        return attempt;
+    }
+    attempt.error = waitForExec(pid, execPipe);
+    attempt.inChild = attempt.error != 0;
+    if (!attempt.inChild) attempt.pid = pid;
+    return attempt;
+}
+
+// Helper: Whether a launch error will repeat on every retry until the config or the system changes
+// (missing or non-executable program, bad path), as opposed to transient ones such as EAGAIN or ENOMEM
+static bool isPermanentLaunchError(int error) {
+    switch (error) {
+        case ENOENT: case ENOTDIR: case EACCES: case ENOEXEC: case ELOOP: case ENAMETOOLONG: case EISDIR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Starts a process with the given executable and arguments (a shell-style command line)
+void LinuxApiWrapper::startProcess(const std::string& exe, const std::string& args) {
+    ProcessInfo info(exe, args);
+    LaunchAttempt attempt = spawn(info);
+    if (attempt.pid < 0) {
+        logToWindowsEventLog("Failed to start process: " + exe + " (" + std::strerror(attempt.error) + ")",
+                             WDOG_LOG_WARNING);
+        return;
+    }
+    trackChild(attempt.pid, info.getArgv()[0]);
+}
+
+// Starts a process of a config entry with the given setup. Cgroup entries are created inside their
+// cgroup by clone3, from the launch helper when it runs (or join it after fork on older kernels).
+// Entries with listening sockets, stored fds or a standby socket are cloned from here, as those have to
+// be put in place between fork and exec, and entries with an environment of their own never go through
+// the helper. Every path learns synchronously whether exec succeeded
+LaunchAttempt LinuxApiWrapper::launchEntry(const std::string& name, const ProcessInfo& launch, const ChildSetup& setup) {
+    const bool inCgroup = cgroups.hasService(name);
+    LaunchAttempt attempt;
+    if (!inCgroup && setup.listenCount == 0 && setup.standbyFd < 0) {
+        return spawn(launch, setup.outputFd, setup.envp);
+    }
+    bool direct = true;
+    if (inCgroup && setup.envp == nullptr && clone3Usable && helper.isRunning()) {
+        attempt = helper.launch(launch, cgroups.dirFd(name), setup.outputFd);
+        // Arguments too large for a request, or the helper is gone: launch it from here instead
+        direct = attempt.error == EMSGSIZE || attempt.error == EPIPE;
+    }
+    if (direct && clone3Usable) attempt = cloneChild(launch, inCgroup ? cgroups.dirFd(name) : -1, setup);
+    if (attempt.pid < 0 && !attempt.inChild &&
+        (attempt.error == ENOSYS || attempt.error == E2BIG || attempt.error == EINVAL)) {
+        logToWindowsEventLog("clone3 is not supported, launching with fork (and joining cgroups after it) instead",
+                             WDOG_LOG_WARNING);
+        clone3Usable = false;
+        direct = true;
+    }
+    if (direct && !clone3Usable) {
+        int procsFd = inCgroup ? cgroups.openProcs(name) : -1;
+        if (inCgroup && procsFd < 0) {
+            attempt = LaunchAttempt();
+            attempt.error = errno;
         } else {
-            execlp(exe.c_str(), exe.c_str(), (char*)nullptr);
+            attempt = forkChild(launch, procsFd, setup);
+            if (procsFd >= 0) close(procsFd);
         }
-        // If execlp fails, print an error and exit
-        std::cerr << "Failed to start process: " << exe << std::endl;
-        _exit(1);
     }
-    // Parent process does nothing
+    return attempt;
 }
 
-// Sends SIGTERM to all processes with the given name
+// Starts a config entry from the launch spec prepared by configure(). A cgroup entry's cgroup counts
+// as populated from now on, so the entry is not started twice before the kernel reports the change.
+// A missing or broken executable is reported as Unlaunchable right here
+LaunchResult LinuxApiWrapper::startService(const ProcessInfo& info) {
+    const std::string name = info.getName();
+    auto spec = launchSpecs.find(name);
+    if (spec == launchSpecs.end()) {
+        startProcess(info.getExe(), info.getArgs());
+        return LaunchResult::Started;
+    }
+    const ProcessInfo& launch = spec->second;
+    prefetcher.prefetch(name);
+    ChildSetup setup;
+    setup.outputFd = output.outputFd(name);
+    sockets.prepare(name, setup);
+    LaunchAttempt attempt = launchEntry(name, launch, setup);
+    if (attempt.pid < 0) {
+        logToWindowsEventLog("Failed to start process: " + name + " (" + std::strerror(attempt.error) + ")",
+                             WDOG_LOG_WARNING);
+        return isPermanentLaunchError(attempt.error) ? LaunchResult::Unlaunchable : LaunchResult::Failed;
+    }
+    trackChild(attempt.pid, launch.getArgv()[0], attempt.pidfd, name);
+    if (cgroups.hasService(name)) cgroups.markPopulated(name);
+    auto pool = standbys.find(name);
+    if (pool != standbys.end()) pool->second.active = attempt.pid;
+    return LaunchResult::Started;
+}
+
+// Starts one standby instance of an entry: like a normal launch, plus one end of a socketpair at the fd
+// named by WATCHDOG_STANDBY_FD. The instance initializes, then blocks reading it: one byte means it has
+// been promoted, end of file that it is no longer needed. Returns false if the launch failed
+bool LinuxApiWrapper::startStandby(const std::string& name, StandbyPool& pool) {
+    auto spec = launchSpecs.find(name);
+    if (spec == launchSpecs.end()) return false;
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) {
+        standbyFailed(pool);
+        return false;
+    }
+    ChildSetup setup;
+    setup.outputFd = output.outputFd(name);
+    setup.standbyFd = pair[1];
+    sockets.prepare(name, setup, true);
+    LaunchAttempt attempt = launchEntry(name, spec->second, setup);
+    close(pair[1]);
+    if (attempt.pid < 0) {
+        close(pair[0]);
+        logToWindowsEventLog("Failed to start a standby instance of " + name + " (" + std::strerror(attempt.error) + ")",
+                             WDOG_LOG_WARNING);
+        standbyFailed(pool);
+        return false;
+    }
+    trackChild(attempt.pid, spec->second.getArgv()[0], attempt.pidfd, name);
+    pool.idle.push_back(Standby{ attempt.pid, pair[0] });
+    return true;
+}
+
+// Tops up the standby pools of entries whose active instance the watchdog started and that is running.
+// After a standby died or failed to start, the next attempt waits 1 s, doubling up to a minute
+void LinuxApiWrapper::refillStandbys() {
+    const auto now = std::chrono::steady_clock::now();
+    for (auto& entry : standbys) {
+        StandbyPool& pool = entry.second;
+        while (pool.active >= 0 && pool.idle.size() < pool.target && now >= pool.retryAt) {
+            if (!startStandby(entry.first, pool)) break;
+        }
+    }
+}
+
+void LinuxApiWrapper::standbyFailed(StandbyPool& pool) {
+    ++pool.failures;
+    long long delayMs = 1000LL << std::min(pool.failures - 1, 6u);
+    pool.retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::min(delayMs, 60000LL));
+}
+
+// Called for every reaped process of an entry with standbys. When the active instance exits, the oldest
+// standby that is still alive is promoted on the spot, so the entry never looks down to the monitor;
+// an "on-failure" entry that exited cleanly is meant to stay down, so its standbys are stopped instead
+void LinuxApiWrapper::standbyExited(const std::string& service, const ProcessExit& exit) {
+    StandbyPool& pool = standbys[service];
+    for (auto it = pool.idle.begin(); it != pool.idle.end(); ++it) {
+        if (it->pid != exit.pid) continue;
+        close(it->promoteFd);
+        pool.idle.erase(it);
+        standbyFailed(pool);
+        return;
+    }
+    if (exit.pid != pool.active) return;
+    pool.active = -1;
+    auto spec = launchSpecs.find(service);
+    if (exit.signal == 0 && exit.exitCode == 0 && spec != launchSpecs.end() &&
+        spec->second.getRestartPolicy() == RestartPolicy::OnFailure) {
+        retireStandbys(pool, 0);
+        return;
+    }
+    while (!pool.idle.empty()) {
+        Standby next = pool.idle.front();
+        pool.idle.pop_front();
+        const char promote = 1;
+        bool promoted = send(next.promoteFd, &promote, 1, MSG_NOSIGNAL | MSG_DONTWAIT) == 1;
+        close(next.promoteFd);
+        if (promoted) {
+            pool.active = next.pid;
+            pool.failures = 0;
+            pool.retryAt = std::chrono::steady_clock::time_point();
+            logToWindowsEventLog("Promoted standby instance " + std::to_string(next.pid) + " of " + service);
+            return;
+        }
+        stopProcess(next.pid); // exiting already; it is reaped like any other child
+    }
+}
+
+// Stops the newest idle instances of a pool until at most keep are left
+void LinuxApiWrapper::retireStandbys(StandbyPool& pool, size_t keep) {
+    while (pool.idle.size() > keep) {
+        close(pool.idle.back().promoteFd);
+        stopProcess(pool.idle.back().pid);
+        pool.idle.pop_back();
+    }
+}
+
+// Sizes the standby pools of launchable entries with "standby"; pools of entries that lost their
+// standbys, and instances beyond a lowered count, are stopped
+void LinuxApiWrapper::configureStandbys(const ConfigManager& cfg) {
+    std::unordered_map<std::string, StandbyPool> pools;
+    for (const auto& p : cfg.getProcesses()) {
+        if (p.getExe().empty() || p.getStandby() == 0) continue;
+        auto old = standbys.find(p.getName());
+        StandbyPool pool;
+        if (old != standbys.end()) {
+            pool = old->second;
+            standbys.erase(old);
+        }
+        pool.target = p.getStandby();
+        retireStandbys(pool, pool.target);
+        pools[p.getName()] = pool;
+    }
+    for (auto& entry : standbys) retireStandbys(entry.second, 0);
+    standbys = pools;
+}
+
+// Stops all processes with the given name, or every member of a cgroup entry: each gets SIGTERM now
+// and SIGKILL if it is still running after the grace period (see stopProcess). Standby instances are
+// stopped too, and none is promoted. Returns right away; the event loop finishes the stops
 void LinuxApiWrapper::killProcess(const std::string& name) {
-    auto pids = getPidsByName(name);
+    auto pool = standbys.find(name);
+    if (pool != standbys.end()) {
+        pool->second.active = -1;
+        retireStandbys(pool->second, 0);
+    }
+    std::vector<pid_t> pids;
+    if (cgroups.hasService(name)) {
+        pids = cgroups.members(name);
+    } else if (inTick) {
+        pids = snapshotPids(name);
+        for (pid_t pid : pids) forgetPid(pid);
+    } else {
+        pids = getPidsByName(name);
+    }
     for (pid_t pid : pids) {
+        stopProcess(pid);
+    }
+}
+
+// Sends SIGTERM through a pidfd (the tracked child's, or one opened now) and arms the SIGKILL deadline.
+// Without pidfds (Linux < 5.3) or an event loop the process only gets SIGTERM, as a PID alone cannot be
+// told apart from a reused one by the time the grace period is over
+void LinuxApiWrapper::stopProcess(pid_t pid) {
+    if (stopping.count(pid) > 0) return;
+    auto child = children.find(pid);
+    int pidfd = child != children.end() ? child->second.pidfd : -1;
+    bool own = false;
+    if (pidfd < 0 && epollFd >= 0) {
+        pidfd = pidfdOpen(pid);
+        own = pidfd >= 0;
+    }
+    if (pidfd < 0 || epollFd < 0) {
         kill(pid, SIGTERM);
+        return;
+    }
+    if (pidfdSendSignal(pidfd, SIGTERM) < 0) {
+        // ESRCH: it has exited already
+        if (own) close(pidfd);
+        return;
+    }
+    // Tracked children are watched already; their exit ends the stop in reapChildren
+    if (own) watchFd(pidfd, kStoppingPidfd, static_cast<uint32_t>(pid));
+    stopping[pid] = Stopping{ pidfd, own, std::chrono::steady_clock::now() + stopGrace };
+}
+
+// The process has exited (or been reaped): no SIGKILL for it
+void LinuxApiWrapper::finishStop(pid_t pid) {
+    auto it = stopping.find(pid);
+    if (it == stopping.end()) return;
+    if (it->second.ownPidfd) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, it->second.pidfd, nullptr);
+        close(it->second.pidfd);
+    }
+    stopping.erase(it);
+}
+
+// Sends SIGKILL to every stopped process whose grace period is over
+void LinuxApiWrapper::expireStops() {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<pid_t> due;
+    for (const auto& s : stopping) {
+        if (now >= s.second.deadline) due.push_back(s.first);
+    }
+    for (pid_t pid : due) {
+        if (pidfdSendSignal(stopping[pid].pidfd, SIGKILL) == 0) {
+            logToWindowsEventLog("Process " + std::to_string(pid) + " did not stop within " +
+                                 std::to_string(stopGrace.count()) + " ms, sent SIGKILL", WDOG_LOG_WARNING);
+        }
+        finishStop(pid);
     }
 }
 
@@ -1,17 +1,185 @@
 #pragma once
 #include "OSApiWrapper.h"
+#include "CgroupManager.h"
+#include "ExecPrefetch.h"
+#include "LaunchHelper.h"
+#include "ListenSockets.h"
+#include "NotifySocket.h"
+#include "OutputCapture.h"
+#include "ProcConnector.h"
+#include "ProcScanner.h"
+#include "ProcessMatcher.h"
+#include <sys/types.h>
+#include <signal.h>
+#include <spawn.h>
+#include <chrono>
+#include <deque>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
+// How LinuxApiWrapper finds out which processes are running
+enum class DiscoveryBackend {
+    Scan,          // full /proc scans, at most once per reconcile interval
+    ProcConnector  // live index fed by kernel proc connector events; falls back to Scan without privileges
+};
+
 // Concrete implementation of OSApiWrapper for Linux
 class LinuxApiWrapper : public OSApiWrapper {
 public:
-    LinuxApiWrapper() = default;
-    ~LinuxApiWrapper() override = default;
+    // With launchHelper ("launch_helper" of the initial config) the launch helper is forked right away,
+    // before anything else is allocated; configure() only starts or stops it when a reload changes it
+    explicit LinuxApiWrapper(DiscoveryBackend backend = DiscoveryBackend::Scan, bool launchHelper = false);
+    ~LinuxApiWrapper() override;
+    LinuxApiWrapper(const LinuxApiWrapper&) = delete;
+    LinuxApiWrapper& operator=(const LinuxApiWrapper&) = delete;
 
     bool isProcessRunning(const std::string& name) override;
     void startProcess(const std::string& exe, const std::string& args) override;
+    LaunchResult startService(const ProcessInfo& info) override;
     void killProcess(const std::string& name) override;
     void bringToForeground(const std::string& name) override;
     bool isProcessInForeground(const std::string& name) override;
-};
\ No newline at end of file
+
+    void configure(const ConfigManager& cfg) override;
+    void beginTick() override;
+    void endTick() override;
+    bool waitForEvents(int timeoutMs) override;
+    std::vector<ProcessExit> takeExitedProcesses() override;
+private:
+    // A child started by startProcess
+    struct TrackedChild {
+        int pidfd;        // -1 if pidfd_open is not supported
+        std::string name;
+        std::string service; // config entry it was started for, empty if none
+    };
+
+    // Idle instance of an entry with "standby", blocked reading its end of a socketpair until promoted
+    struct Standby {
+        pid_t pid;
+        int promoteFd; // our end: one byte promotes the instance, closing it tells the instance to exit
+    };
+    struct StandbyPool {
+        unsigned target = 0;
+        pid_t active = -1;        // the serving instance, if the watchdog started it
+        std::deque<Standby> idle; // oldest (most likely done initializing) first
+        unsigned failures = 0;    // standby instances that died or did not start since the last promotion
+        std::chrono::steady_clock::time_point retryAt;
+    };
+
+    // A process being stopped: SIGTERM was sent, SIGKILL follows at deadline unless it exits first
+    struct Stopping {
+        int pidfd;      // signals go through it, so a reused PID cannot be hit
+        bool ownPidfd;  // opened for the stop and watched as kStoppingPidfd (not a tracked child's)
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    // What the snapshot knows about one running process
+    struct ProcRecord {
+        std::string name;
+        std::vector<size_t> rules; // config entries (matcher rules) it matches
+    };
+
+    std::vector<pid_t> getPidsByName(const std::string& name);
+    std::vector<pid_t> snapshotPids(const std::string& name) const;
+    bool readComm(pid_t pid, std::string& name);
+    void rescanProcessTable();
+    void indexPid(pid_t pid, const std::string& name);
+    bool forgetPid(pid_t pid);
+    bool applyConnectorEvents();
+    void watchFd(int fd, uint32_t source, uint32_t value);
+    bool reapChildren();
+    LaunchAttempt spawn(const ProcessInfo& info, int outputFd = -1, char* const* envp = nullptr);
+    LaunchAttempt launchEntry(const std::string& name, const ProcessInfo& launch, const ChildSetup& setup);
+    LaunchAttempt cloneChild(const ProcessInfo& info, int cgroupFd, const ChildSetup& setup);
+    LaunchAttempt forkChild(const ProcessInfo& info, int cgroupProcsFd, const ChildSetup& setup);
+    void stopProcess(pid_t pid);
+    void finishStop(pid_t pid);
+    void expireStops();
+    void trackChild(pid_t pid, const std::string& exe, int pidfd = -1, const std::string& service = std::string());
+    void configureCgroups(const ConfigManager& cfg);
+    void configureLaunchHelper(bool wanted);
+    void configureOutputCapture(const ConfigManager& cfg);
+    void configureListenSockets(const ConfigManager& cfg);
+    void receiveStoredFds();
+    void configureStandbys(const ConfigManager& cfg);
+    void refillStandbys();
+    bool startStandby(const std::string& name, StandbyPool& pool);
+    void standbyExited(const std::string& service, const ProcessExit& exit);
+    void standbyFailed(StandbyPool& pool);
+    void retireStandbys(StandbyPool& pool, size_t keep);
+    std::string serviceOfPid(pid_t pid) const;
+
+    // Process table snapshot: comm -> PIDs, config entry -> PIDs, and the reverse PID -> record index.
+    // It is reconciled with an incremental /proc scan at most once per reconcile interval and kept up
+    // to date in between by child exit events, or entirely by proc connector events when that backend
+    // is active, so every query made during a monitor tick is answered without touching /proc.
+    // Each process is classified against all config entries once, when it enters the index.
+    std::unordered_map<std::string, std::vector<pid_t>> snapshot;
+    std::unordered_map<pid_t, ProcRecord> records;
+    ProcessMatcher matcher;
+    std::vector<std::vector<pid_t>> rulePids;
+    std::vector<size_t> matchHits; // reused buffer for matcher.match()
+    ProcScanner scanner;
+    std::vector<ProcEntry> scanBuffer; // reused between scans to avoid reallocating
+    ProcDelta scanDelta;
+    std::chrono::steady_clock::time_point lastScan;
+    bool snapshotValid = false;
+    bool inTick = false;
+
+    ProcConnector connector;
+    std::vector<ProcConnector::Event> connectorEvents; // reused buffer for drain()
+
+    int epollFd = -1;
+    std::unordered_map<pid_t, TrackedChild> children;
+
+    // SIGCHLD is blocked and read from a signalfd, so children are reaped with wait4 from the event loop
+    int signalFd = -1;
+    sigset_t childMask;
+    sigset_t originalMask; // restored in children before exec
+    std::vector<ProcessExit> exits;
+
+    // posix_spawn settings shared by every launch: restore the original signal mask and close every
+    // inherited fd above stderr in the child
+    posix_spawnattr_t spawnAttr;
+    posix_spawn_file_actions_t spawnActions;
+    // Config entries that can be launched, by name; each carries the argv tokenized at config load,
+    // so a restart only has to call posix_spawn
+    std::unordered_map<std::string, ProcessInfo> launchSpecs;
+
+    // Entries with "cgroup": true run in their own cgroup v2 directory; their liveness is the cgroup's
+    // populated flag instead of a name lookup in the snapshot
+    CgroupManager cgroups;
+    int watchedCgroupFd = -1; // inotify fd of cgroups currently registered with epoll
+    unsigned watchedCgroupGeneration = 0; // CgroupManager::generation() it belongs to
+    bool clone3Usable = true; // false once clone3 (with CLONE_INTO_CGROUP) turned out to be unsupported
+
+    // Pre-forked launcher for config entries ("launch_helper"); when it is not running, entries are
+    // launched from the watchdog itself
+    LaunchHelper helper;
+
+    // stdout and stderr of config entries, spliced into ring log files ("log_dir"); when it is not
+    // ready, children inherit the watchdog's stdout
+    OutputCapture output;
+
+    // Listening sockets of config entries ("listen"), held open across restarts and passed to every
+    // process of the entry (socket activation), along with the fds the entry's processes stored
+    // through the notify socket ("fd_store"), which is opened once the first entry has an fd store
+    ListenSockets sockets;
+    NotifySocket notify;
+
+    // Standby instances of entries with "standby". When the active instance exits, the oldest standby is
+    // promoted right where the exit is reaped, with a single write, instead of starting a new process
+    // (see standbyExited); the pool is refilled at the end of the tick
+    std::unordered_map<std::string, StandbyPool> standbys;
+
+    // Processes stopped by killProcess (or retired standbys) that have not exited yet. Their pidfds are
+    // watched by the event loop, which escalates to SIGKILL after the grace period ("stop_grace_ms"),
+    // so stopping never blocks the monitor
+    std::unordered_map<pid_t, Stopping> stopping;
+    std::chrono::milliseconds stopGrace{ 10000 };
+
+    // Files that entries with "readahead" load at exec, pulled into the page cache when such an entry's
+    // process exits and again before it is started
+    ExecPrefetch prefetcher;
+};
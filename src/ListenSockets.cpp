@@ -0,0 +1,305 @@
+/*
+    ListenSockets.cpp - Socket activation for monitored services ("listen")
+
+    Why?
+    ----
+    A server that crashes takes its listening socket with it. Until the restarted process has bound its
+    port again, every client gets "connection refused", so a restart shows up as a burst of errors.
+    When the watchdog owns the socket instead, it never closes: connections that arrive while the
+    service is down wait in the socket's accept queue (up to the backlog) and are accepted by the new
+    process, so a restart only costs those clients some latency.
+
+    Protocol (sd_listen_fds(3), understood by systemd-aware servers and easy to support by hand):
+    - the sockets are fds 3, 4, ... in the order of "listen"
+    - LISTEN_FDS is their number, LISTEN_PID the PID of the process they are meant for, and
+      LISTEN_FDNAMES the entry name for each of them, separated by ':'
+    LISTEN_PID is only known in the child, so socket-activated entries are started with clone3/fork,
+    which fill it in between fork and exec (see setupChild), not with posix_spawn.
+
+    Fds a service stored through its fd store (NotifySocket) follow the sockets, named by their FDNAME,
+    so a replacement finds its predecessor's connections and caches the same way it finds its sockets.
+*/
+
+#include "ListenSockets.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include "Logger.h"
+
+extern char** environ;
+
+// Helper: Open, bind and (for stream sockets) listen on one "listen" address. Returns the fd, or -1
+// with errno set
+static int openSocket(const std::string& spec) {
+    std::string address = spec;
+    int type = SOCK_STREAM;
+    if (address.compare(0, 4, "udp:") == 0) {
+        type = SOCK_DGRAM;
+        address.erase(0, 4);
+    } else if (address.compare(0, 4, "tcp:") == 0) {
+        address.erase(0, 4);
+    }
+
+    sockaddr_storage storage;
+    std::memset(&storage, 0, sizeof(storage));
+    socklen_t length = 0;
+    bool dualStack = false;
+    if (!address.empty() && address[0] == '/') {
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&storage);
+        if (address.size() >= sizeof(un->sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, address.c_str(), address.size() + 1);
+        length = sizeof(sockaddr_un);
+    } else {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? std::string() : address.substr(0, colon);
+        std::string portText = colon == std::string::npos ? address : address.substr(colon + 1);
+        char* end = nullptr;
+        unsigned long port = std::strtoul(portText.c_str(), &end, 10);
+        if (portText.empty() || *end != '\0' || port == 0 || port > 65535) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (host.empty() || (host.size() > 2 && host[0] == '[' && host.back() == ']')) {
+            sockaddr_in6* in6 = reinterpret_cast<sockaddr_in6*>(&storage);
+            in6->sin6_family = AF_INET6;
+            in6->sin6_port = htons(static_cast<uint16_t>(port));
+            if (host.empty()) {
+                in6->sin6_addr = in6addr_any;
+                dualStack = true;
+            } else if (inet_pton(AF_INET6, host.substr(1, host.size() - 2).c_str(), &in6->sin6_addr) != 1) {
+                errno = EINVAL;
+                return -1;
+            }
+            length = sizeof(sockaddr_in6);
+        } else {
+            sockaddr_in* in4 = reinterpret_cast<sockaddr_in*>(&storage);
+            in4->sin_family = AF_INET;
+            in4->sin_port = htons(static_cast<uint16_t>(port));
+            if (inet_pton(AF_INET, host.c_str(), &in4->sin_addr) != 1) {
+                errno = EINVAL;
+                return -1;
+            }
+            length = sizeof(sockaddr_in);
+        }
+    }
+
+    // Blocking: the flag belongs to the shared open file, and servers expect the default
+    int fd = socket(storage.ss_family, type | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int on = 1;
+    int off = 0;
+    if (storage.ss_family == AF_UNIX) {
+        // A socket file left behind by an earlier run would make bind fail
+        struct stat st;
+        if (lstat(address.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(address.c_str());
+    } else {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (dualStack) setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr*>(&storage), length) < 0 ||
+        (type == SOCK_STREAM && listen(fd, SOMAXCONN) < 0)) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+ListenSockets::~ListenSockets() {
+    for (const auto& s : services) {
+        for (const Socket& socket : s.second.sockets) closeSocket(socket);
+        for (const Stored& stored : s.second.stored) close(stored.fd);
+    }
+}
+
+void ListenSockets::closeSocket(const Socket& socket) {
+    close(socket.fd);
+    if (!socket.address.empty() && socket.address[0] == '/') unlink(socket.address.c_str());
+}
+
+void ListenSockets::configure(const std::string& service, const std::vector<std::string>& addresses,
+                              size_t storeLimit, const std::string& notifySocket, bool standby) {
+    Service& svc = services[service];
+    std::vector<Socket> sockets;
+    for (const std::string& address : addresses) {
+        auto open = std::find_if(svc.sockets.begin(), svc.sockets.end(),
+                                 [&address](const Socket& s) { return s.address == address; });
+        if (open != svc.sockets.end()) {
+            sockets.push_back(*open);
+            svc.sockets.erase(open);
+            continue;
+        }
+        if (sockets.size() == kMaxListenFds) {
+            logToWindowsEventLog("Too many listen addresses for " + service + ", ignoring " + address,
+                                 WDOG_LOG_WARNING);
+            continue;
+        }
+        int fd = openSocket(address);
+        if (fd < 0) {
+            logToWindowsEventLog("Cannot listen on " + address + " for " + service + ": " + std::strerror(errno),
+                                 WDOG_LOG_WARNING);
+            continue;
+        }
+        sockets.push_back(Socket{ address, fd });
+    }
+    // Whatever is left was dropped from the config
+    for (const Socket& socket : svc.sockets) closeSocket(socket);
+    svc.sockets = sockets;
+    svc.storeLimit = std::min(storeLimit, kMaxListenFds - svc.sockets.size());
+    svc.notifySocket = storeLimit > 0 ? notifySocket : std::string();
+    svc.standby = standby;
+    trimStore(service, svc);
+    buildEnvironment(service, svc);
+}
+
+// Drops the stored fds beyond the limit, oldest first
+void ListenSockets::trimStore(const std::string& service, Service& svc) {
+    if (svc.stored.size() <= svc.storeLimit) return;
+    size_t excess = svc.stored.size() - svc.storeLimit;
+    logToWindowsEventLog("Closing " + std::to_string(excess) + " stored fds of " + service + " beyond its fd_store limit",
+                         WDOG_LOG_WARNING);
+    for (size_t i = 0; i < excess; ++i) close(svc.stored[i].fd);
+    svc.stored.erase(svc.stored.begin(), svc.stored.begin() + static_cast<std::ptrdiff_t>(excess));
+}
+
+bool ListenSockets::storesFds(const std::string& service) const {
+    auto it = services.find(service);
+    return it != services.end() && it->second.storeLimit > 0;
+}
+
+bool ListenSockets::storeFd(const std::string& service, const std::string& name, int fd) {
+    auto it = services.find(service);
+    if (it == services.end() || it->second.storeLimit == 0) {
+        close(fd);
+        return false;
+    }
+    Service& svc = it->second;
+    // A replacement typically stores again what it was passed; keep one copy of each open file
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        for (const Stored& stored : svc.stored) {
+            struct stat other;
+            if (fstat(stored.fd, &other) == 0 && other.st_dev == st.st_dev && other.st_ino == st.st_ino) {
+                close(fd);
+                return false;
+            }
+        }
+    }
+    if (svc.stored.size() >= svc.storeLimit) {
+        logToWindowsEventLog("The fd store of " + service + " is full, dropping an fd named " + name, WDOG_LOG_WARNING);
+        close(fd);
+        return false;
+    }
+    svc.stored.push_back(Stored{ name, fd });
+    buildEnvironment(service, svc);
+    return true;
+}
+
+void ListenSockets::removeStored(const std::string& service, const std::string& name) {
+    auto it = services.find(service);
+    if (it == services.end()) return;
+    Service& svc = it->second;
+    auto kept = std::remove_if(svc.stored.begin(), svc.stored.end(), [&name](const Stored& stored) {
+        if (stored.name != name) return false;
+        close(stored.fd);
+        return true;
+    });
+    if (kept == svc.stored.end()) return;
+    svc.stored.erase(kept, svc.stored.end());
+    buildEnvironment(service, svc);
+}
+
+// The watchdog's environment without any LISTEN_*, NOTIFY_SOCKET or WATCHDOG_STANDBY_FD it may have been
+// started with, plus the variables describing the fds of the service. LISTEN_PID holds room for the
+// digits setupChild() writes
+void ListenSockets::buildEnvironment(const std::string& service, Service& svc) {
+    svc.fds.clear();
+    std::string names;
+    for (const Socket& socket : svc.sockets) {
+        svc.fds.push_back(socket.fd);
+        names += (names.empty() ? "" : ":") + service;
+    }
+    for (const Stored& stored : svc.stored) {
+        svc.fds.push_back(stored.fd);
+        names += (svc.fds.size() > 1 ? ":" : "") + stored.name;
+    }
+    std::vector<std::string> vars;
+    if (!svc.fds.empty() || !svc.notifySocket.empty() || svc.standby) {
+        for (char** var = environ; var != nullptr && *var != nullptr; ++var) {
+            if (std::strncmp(*var, "LISTEN_", 7) != 0 && std::strncmp(*var, "NOTIFY_SOCKET=", 14) != 0 &&
+                std::strncmp(*var, "WATCHDOG_STANDBY_FD=", 20) != 0) {
+                vars.push_back(*var);
+            }
+        }
+        if (!svc.notifySocket.empty()) vars.push_back("NOTIFY_SOCKET=" + svc.notifySocket);
+        if (!svc.fds.empty()) {
+            vars.push_back("LISTEN_FDS=" + std::to_string(svc.fds.size()));
+            vars.push_back("LISTEN_FDNAMES=" + names);
+        }
+    }
+    fillEnvironment(svc.env, vars);
+    svc.standbyEnv = Environment();
+    if (svc.standby) {
+        // The promotion socket follows the passed fds
+        vars.push_back("WATCHDOG_STANDBY_FD=" + std::to_string(3 + svc.fds.size()));
+        fillEnvironment(svc.standbyEnv, vars);
+    }
+}
+
+// Helper: Make env hold vars, followed by the LISTEN_PID slot when vars announce fds
+void ListenSockets::fillEnvironment(Environment& env, const std::vector<std::string>& vars) {
+    env.vars = vars;
+    env.envp.clear();
+    if (env.vars.empty()) return;
+    bool listening = std::any_of(env.vars.begin(), env.vars.end(),
+                                 [](const std::string& var) { return var.compare(0, 11, "LISTEN_FDS=") == 0; });
+    if (listening) {
+        env.listenPid = env.vars.size();
+        env.vars.push_back("LISTEN_PID=" + std::string(15, '0'));
+    }
+    for (std::string& var : env.vars) env.envp.push_back(&var[0]);
+    env.envp.push_back(nullptr);
+}
+
+void ListenSockets::removeService(const std::string& service) {
+    auto it = services.find(service);
+    if (it == services.end()) return;
+    for (const Socket& socket : it->second.sockets) closeSocket(socket);
+    for (const Stored& stored : it->second.stored) close(stored.fd);
+    services.erase(it);
+}
+
+std::vector<std::string> ListenSockets::serviceNames() const {
+    std::vector<std::string> names;
+    for (const auto& s : services) names.push_back(s.first);
+    return names;
+}
+
+void ListenSockets::prepare(const std::string& service, ChildSetup& setup, bool standby) {
+    auto it = services.find(service);
+    if (it == services.end()) return;
+    Service& svc = it->second;
+    applyEnvironment(standby && svc.standby ? svc.standbyEnv : svc.env, svc, setup);
+}
+
+void ListenSockets::applyEnvironment(Environment& env, const Service& svc, ChildSetup& setup) {
+    if (env.envp.empty()) return;
+    setup.envp = env.envp.data();
+    if (svc.fds.empty()) return;
+    setup.listenFds = svc.fds.data();
+    setup.listenCount = svc.fds.size();
+    setup.listenPid = &env.vars[env.listenPid][std::strlen("LISTEN_PID=")];
+}
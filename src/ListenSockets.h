@@ -0,0 +1,77 @@
+#pragma once
+#include "LaunchHelper.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Listening sockets the watchdog opens for config entries ("listen") and hands to every process it
+// starts for them, following the socket activation convention of sd_listen_fds(3): the sockets are
+// fds 3, 4, ... and LISTEN_FDS, LISTEN_PID and LISTEN_FDNAMES describe them.
+// The sockets belong to the watchdog and stay open while a service restarts, so the kernel queues
+// incoming connections until the new process accepts them instead of refusing them.
+// Services with an fd store ("fd_store") also get NOTIFY_SOCKET, and the fds their processes stored
+// (see NotifySocket) are passed to later processes after the sockets, under the names they were stored with.
+// Standby instances of entries with "standby" get the same, plus WATCHDOG_STANDBY_FD (see startStandby).
+class ListenSockets {
+public:
+    ListenSockets() = default;
+    ~ListenSockets();
+    ListenSockets(const ListenSockets&) = delete;
+    ListenSockets& operator=(const ListenSockets&) = delete;
+
+    // Opens the sockets a service lists that are not open yet, closes the ones it no longer lists, and
+    // prepares the environment for its processes. Addresses that cannot be opened are logged and skipped.
+    // An address is "[tcp:|udp:]port", "[tcp:|udp:]ipv4:port", "[tcp:|udp:][ipv6]:port" or a unix
+    // socket path (starting with '/'); a bare port listens on all IPv4 and IPv6 addresses.
+    // storeLimit is the most fds the service may store, notifySocket the NOTIFY_SOCKET to announce then,
+    // and standby whether the service has standby instances
+    void configure(const std::string& service, const std::vector<std::string>& addresses,
+                   size_t storeLimit = 0, const std::string& notifySocket = std::string(), bool standby = false);
+    // Closes the sockets and stored fds of a service (its running processes keep their copies)
+    void removeService(const std::string& service);
+    bool storesFds(const std::string& service) const;
+    // Takes ownership of fd and passes it to the service's later processes. An fd that is stored
+    // already (the same open file) is closed and kept once; so is an fd beyond the limit, which is
+    // logged. Returns whether fd was added
+    bool storeFd(const std::string& service, const std::string& name, int fd);
+    // Closes the stored fds of the service with the given name
+    void removeStored(const std::string& service, const std::string& name);
+    bool hasService(const std::string& service) const { return services.count(service) > 0; }
+    std::vector<std::string> serviceNames() const;
+
+    // Adds the sockets and stored fds of the service, and the environment announcing them, to the
+    // setup of a launch. A standby launch also announces setup.standbyFd, which must be set
+    void prepare(const std::string& service, ChildSetup& setup, bool standby = false);
+private:
+    struct Socket {
+        std::string address;
+        int fd;
+    };
+    struct Environment {
+        std::vector<std::string> vars; // the watchdog's environment with LISTEN_* etc. set
+        std::vector<char*> envp;       // pointers into vars, NULL-terminated; empty if not needed
+        size_t listenPid = 0;          // index of LISTEN_PID in vars
+    };
+    struct Stored {
+        std::string name;
+        int fd;
+    };
+    struct Service {
+        std::vector<Socket> sockets;
+        std::vector<Stored> stored;
+        size_t storeLimit = 0;
+        std::string notifySocket;      // empty without an fd store
+        bool standby = false;
+        std::vector<int> fds;          // of sockets, then of stored, in order
+        Environment env;
+        Environment standbyEnv;        // env plus WATCHDOG_STANDBY_FD, if standby
+    };
+
+    static void closeSocket(const Socket& socket);
+    void buildEnvironment(const std::string& service, Service& svc);
+    static void fillEnvironment(Environment& env, const std::vector<std::string>& vars);
+    static void applyEnvironment(Environment& env, const Service& svc, ChildSetup& setup);
+    void trimStore(const std::string& service, Service& svc);
+
+    std::unordered_map<std::string, Service> services;
+};
@@ -0,0 +1,128 @@
+/*
+    NotifySocket.cpp - Receiving side of the fd store ("fd_store")
+
+    Why?
+    ----
+    A service that restarts normally loses everything it held: its client connections and whatever it
+    had cached in memory. If it hands those fds to the watchdog on its way out, the watchdog can pass
+    them to its replacement (see ListenSockets), which then continues with warm caches and open
+    connections instead of rebuilding them.
+
+    Protocol (the fd store part of sd_notify(3), so sd_pid_notify_with_fds() works unchanged):
+    - NOTIFY_SOCKET names an AF_UNIX datagram socket; '@' at its start means the abstract namespace
+    - a message is newline-separated KEY=VALUE lines plus an SCM_RIGHTS control message with the fds
+    - "FDSTORE=1" stores the fds, "FDSTOREREMOVE=1" drops those stored under FDNAME, and "FDNAME=" names
+      them (printable ASCII without ':', at most 255 characters; "stored" by default)
+    Other keys are ignored. SO_PASSCRED makes the kernel attach the sender's PID to every message.
+*/
+
+#include "NotifySocket.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include "LaunchHelper.h"
+#include "Logger.h"
+
+// Helper: Whether a name can be passed on in LISTEN_FDNAMES
+static bool isValidFdName(const std::string& name) {
+    if (name.empty() || name.size() > 255) return false;
+    for (char c : name) {
+        if (c < 0x21 || c > 0x7e || c == ':') return false;
+    }
+    return true;
+}
+
+bool NotifySocket::open() {
+    if (sock >= 0) return true;
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return false;
+    // Abstract: no file to create or clean up; it is unique to this watchdog and gone when it exits
+    std::string path = "watchdog/" + std::to_string(getpid()) + "/notify";
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path + 1, path.c_str(), path.size());
+    socklen_t length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + path.size());
+    int on = 1;
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), length) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on)) < 0) {
+        int error = errno;
+        ::close(fd);
+        errno = error;
+        return false;
+    }
+    sock = fd;
+    name = "@" + path;
+    return true;
+}
+
+void NotifySocket::close() {
+    if (sock >= 0) ::close(sock);
+    sock = -1;
+    name.clear();
+}
+
+void NotifySocket::receive(std::vector<Message>& messages) {
+    if (sock < 0) return;
+    char text[4096];
+    union {
+        cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(ucred)) + CMSG_SPACE(kMaxListenFds * sizeof(int))];
+    } control;
+    while (true) {
+        iovec iov = { text, sizeof(text) - 1 };
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        ssize_t n = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        Message message;
+        bool hasCredentials = false;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c != nullptr; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level != SOL_SOCKET) continue;
+            if (c->cmsg_type == SCM_CREDENTIALS && c->cmsg_len == CMSG_LEN(sizeof(ucred))) {
+                ucred cred;
+                std::memcpy(&cred, CMSG_DATA(c), sizeof(cred));
+                message.pid = cred.pid;
+                hasCredentials = true;
+            } else if (c->cmsg_type == SCM_RIGHTS) {
+                size_t count = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                const unsigned char* data = CMSG_DATA(c);
+                for (size_t i = 0; i < count; ++i) {
+                    int fd;
+                    std::memcpy(&fd, data + i * sizeof(int), sizeof(int));
+                    message.fds.push_back(fd);
+                }
+            }
+        }
+        text[n] = '\0';
+        std::string fdName = "stored";
+        for (const char* line = text; *line != '\0';) {
+            const char* end = std::strchr(line, '\n');
+            std::string field = end != nullptr ? std::string(line, end) : std::string(line);
+            if (field == "FDSTORE=1") message.store = true;
+            if (field == "FDSTOREREMOVE=1") message.remove = true;
+            if (field.compare(0, 7, "FDNAME=") == 0) fdName = field.substr(7);
+            if (end == nullptr) break;
+            line = end + 1;
+        }
+        message.fdName = fdName;
+        if (!hasCredentials || (msg.msg_flags & (MSG_CTRUNC | MSG_TRUNC)) != 0 || !isValidFdName(fdName)) {
+            logToWindowsEventLog("Ignoring malformed fd store message" +
+                                 (hasCredentials ? " from PID " + std::to_string(message.pid) : std::string()),
+                                 WDOG_LOG_WARNING);
+            for (int fd : message.fds) ::close(fd);
+            continue;
+        }
+        messages.push_back(message);
+    }
+}
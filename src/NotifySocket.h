@@ -0,0 +1,40 @@
+#pragma once
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+// Datagram socket through which processes of entries with "fd_store" hand fds (listening sockets,
+// client connections, memfds holding caches) to the watchdog before they exit, using the sd_notify(3)
+// protocol: the socket's address is passed in NOTIFY_SOCKET, and a message "FDSTORE=1" with
+// "FDNAME=<name>" carries the fds as SCM_RIGHTS. The kernel attaches the sender's credentials to every
+// message, so the watchdog knows which entry a message comes from without trusting its content.
+class NotifySocket {
+public:
+    // One received message. Its fds are owned by whoever takes the message
+    struct Message {
+        pid_t pid = 0;         // sender, as vouched for by the kernel (SCM_CREDENTIALS)
+        std::vector<int> fds;  // received with O_CLOEXEC
+        bool store = false;    // FDSTORE=1: keep fds
+        bool remove = false;   // FDSTOREREMOVE=1: drop the stored fds named fdName
+        std::string fdName;    // FDNAME=, "stored" if the message has none
+    };
+
+    NotifySocket() = default;
+    ~NotifySocket() { close(); }
+    NotifySocket(const NotifySocket&) = delete;
+    NotifySocket& operator=(const NotifySocket&) = delete;
+
+    // Binds the socket to an abstract address unique to this watchdog. Returns false if that fails
+    bool open();
+    void close();
+    bool isOpen() const { return sock >= 0; }
+    int fd() const { return sock; }
+    // Value for NOTIFY_SOCKET ('@' stands for the abstract namespace)
+    const std::string& address() const { return name; }
+
+    // Reads every pending message (the socket is non-blocking)
+    void receive(std::vector<Message>& messages);
+private:
+    int sock = -1;
+    std::string name;
+};
@@ -1,5 +1,31 @@
 #pragma once
 #include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "ProcessInfo.h"
+
+class ConfigManager;
+
+// Exit of a process started through startProcess, as reported by the OS layer
+struct ProcessExit {
+    std::string name;      // executable it was started as
+    std::string service;   // config entry it was started for, empty if it was started some other way
+    int pid = 0;
+    int exitCode = -1;     // exit status if it exited normally, -1 if it was killed by a signal
+    int signal = 0;        // signal that terminated it, 0 if it exited normally
+    double userCpuSeconds = 0;
+    double systemCpuSeconds = 0;
+    long maxRssKb = 0;     // peak resident set size
+    std::string output;    // latest captured output of the service if it failed ("log_dir"), else empty
+};
+
+// Outcome of starting a config entry
+enum class LaunchResult {
+    Started,
+    Failed,      // may work on a later attempt (e.g. out of memory or process slots)
+    Unlaunchable // will fail the same way until the config or the system changes (e.g. missing executable)
+};
 
 class OSApiWrapper {
 public:
@@ -13,4 +39,35 @@ public:
     virtual void killProcess(const std::string& name) = 0;
     virtual void bringToForeground(const std::string& name) = 0;
     virtual bool isProcessInForeground(const std::string& name) = 0;
+
+    // Starts a configured entry. Implementations that manage entries beyond their executable (e.g. a
+    // cgroup per entry) or can tell why a launch failed override this; the default launches getExe()
+    // with the entry's arguments and reports it as started.
+    virtual LaunchResult startService(const ProcessInfo& info) {
+        startProcess(info.getExe(), info.getArgs());
+        return LaunchResult::Started;
+    }
+
+    // Called by ProcessMonitor when it starts and after every config reload, so an implementation can
+    // prepare per-entry state (e.g. the compiled ProcessMatcher). The default does nothing.
+    virtual void configure(const ConfigManager& /*cfg*/) {}
+
+    // Tick hooks: ProcessMonitor calls beginTick() before it checks its processes and endTick()
+    // once it is done. An implementation may take a single process-table snapshot in beginTick()
+    // and answer every isProcessRunning/killProcess call of that tick from it, instead of
+    // enumerating all processes once per query. The defaults do nothing.
+    virtual void beginTick() {}
+    virtual void endTick() {}
+
+    // Waits until the next monitor tick is due: at most timeoutMs milliseconds, or less if the
+    // implementation learns about a process event (such as a child exiting) earlier.
+    // Returns true if it woke up because of such an event. The default simply sleeps.
+    virtual bool waitForEvents(int timeoutMs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        return false;
+    }
+
+    // Returns (and forgets) the exits of started processes collected since the last call.
+    // The default reports nothing.
+    virtual std::vector<ProcessExit> takeExitedProcesses() { return std::vector<ProcessExit>(); }
 };
\ No newline at end of file
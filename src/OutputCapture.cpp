@@ -0,0 +1,361 @@
+/*
+    OutputCapture.cpp - Per-service capture of stdout/stderr into ring log files
+
+    Before, every child inherited the watchdog's stdout, so the output of all services and the watchdog's
+    own [LOG] lines ended up interleaved in one stream, and nothing bounded its size.
+
+    How it works
+    ------------
+    - Each service gets a pipe when it is configured. Its write end becomes stdout and stderr of every
+      process launched for the service; the watchdog keeps a copy, so the pipe survives restarts and
+      output written between two runs is not lost.
+    - The read end is non-blocking and watched by the event loop. When it becomes readable, the pipe is
+      drained with splice(2) into the log file: the kernel moves the pages from the pipe into the page
+      cache, the bytes are never copied into the watchdog, and a service writing MB/s costs the watchdog
+      a few system calls per wakeup. The pipe is enlarged (F_SETPIPE_SZ) so bursts need fewer wakeups.
+    - The log file has a fixed size ("log_max_bytes"), allocated up front with fallocate, so a chatty
+      service can neither fill the disk nor fail later on a full one. It is a ring: after a header of
+      kHeaderSize bytes the data area is written from start to end and then again from the start.
+    - The file stays mapped (MAP_SHARED). The header is updated through the mapping after every drain,
+      and tail() reads the latest output straight from it, i.e. from the page cache the splice just
+      filled, without any read(2).
+    - A service that is removed (or a log directory that changes) is retired, not closed: the watchdog
+      closes its copy of the write end and keeps draining until the last process holding it has exited,
+      so no running process gets EPIPE.
+
+    File format
+    -----------
+    The header is one text line padded to kHeaderSize bytes: "WDOGLOG1 next=<offset> wrapped=<0|1>".
+    The output in order is bytes [next, end of file) if wrapped is 1, followed by [kHeaderSize, next).
+    Bytes never written are NUL. On restart the watchdog continues at the recorded offset.
+*/
+
+#include "OutputCapture.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "Logger.h"
+
+// Pipe capacity requested for each service (the default is 64 KiB; the limit for unprivileged
+// processes is /proc/sys/fs/pipe-max-size, 1 MiB by default)
+static const int kPipeSize = 256 * 1024;
+// Smallest data area a log file may have
+static const size_t kMinDataBytes = 4096;
+
+// Helper: FNV-1a of a name, as 8 hex digits
+static std::string nameHash(const std::string& name) {
+    unsigned hash = 2166136261u;
+    for (unsigned char c : name) hash = (hash ^ c) * 16777619u;
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08x", hash);
+    return hex;
+}
+
+// Helper: Turn a service name (which may be a glob or regex) into a file name. A name that had to be
+// changed gets a hash of the original appended, so "foo bar" and "foo_bar" do not share a log
+static std::string logFileName(const std::string& service) {
+    std::string file;
+    for (char c : service) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                  c == '-' || c == '_' || c == '.';
+        file += ok ? c : '_';
+    }
+    if (file.empty() || file[0] == '.') file = "_" + file;
+    if (file != service) file += "-" + nameHash(service);
+    return file + ".log";
+}
+
+// Helper: mkdir -p for the log directory
+static bool makeDirs(const std::string& path) {
+    for (size_t pos = 1; pos <= path.size(); ++pos) {
+        if (pos != path.size() && path[pos] != '/') continue;
+        std::string prefix = path.substr(0, pos);
+        if (mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) return false;
+    }
+    return true;
+}
+
+// Helper: The header line for a write position, padded to kHeaderSize bytes
+static void formatHeader(char* header, size_t next, bool wrapped) {
+    std::memset(header, ' ', OutputCapture::kHeaderSize);
+    int length = std::snprintf(header, OutputCapture::kHeaderSize, "WDOGLOG1 next=%zu wrapped=%d", next,
+                               wrapped ? 1 : 0);
+    header[length] = ' ';
+    header[OutputCapture::kHeaderSize - 1] = '\n';
+}
+
+OutputCapture::~OutputCapture() {
+    clear();
+}
+
+void OutputCapture::closeService(Service& svc) {
+    if (svc.readFd >= 0) close(svc.readFd);
+    if (svc.writeFd >= 0) close(svc.writeFd);
+    if (svc.map != nullptr) munmap(svc.map, svc.size);
+    if (svc.fileFd >= 0) close(svc.fileFd);
+    svc = Service();
+}
+
+void OutputCapture::clear() {
+    for (auto& s : services) closeService(s.second);
+    for (auto& r : retired) closeService(r.second);
+    services.clear();
+    retired.clear();
+    pipes.clear();
+    if (dirFd >= 0) close(dirFd);
+    dirFd = -1;
+    dirPath.clear();
+}
+
+bool OutputCapture::init(const std::string& dir, size_t maxBytes, size_t tailBytes) {
+    maxBytes = std::max(maxBytes, kHeaderSize + kMinDataBytes);
+    this->tailBytes = tailBytes;
+    if (dirFd >= 0 && dir == dirPath && maxBytes == this->maxBytes) return true;
+    // Services keep writing into their current files until their processes exit
+    for (const auto& name : serviceNames()) removeService(name);
+    if (dirFd >= 0) close(dirFd);
+    dirFd = -1;
+    dirPath.clear();
+    this->maxBytes = maxBytes;
+    if (!makeDirs(dir)) {
+        logToWindowsEventLog("Cannot create log directory " + dir + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        return false;
+    }
+    dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        logToWindowsEventLog("Cannot open log directory " + dir + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+        return false;
+    }
+    dirPath = dir;
+    return true;
+}
+
+// Opens (or creates) the log file of a service at maxBytes and maps it. A file of the right size with a
+// valid header is continued; anything else starts over
+bool OutputCapture::openLog(Service& svc) {
+    svc.fileFd = openat(dirFd, svc.file.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0640);
+    if (svc.fileFd < 0) return false;
+    svc.size = maxBytes;
+    bool resume = false;
+    struct stat st;
+    char header[kHeaderSize + 1] = {};
+    if (fstat(svc.fileFd, &st) == 0 && static_cast<size_t>(st.st_size) == maxBytes &&
+        pread(svc.fileFd, header, kHeaderSize, 0) == static_cast<ssize_t>(kHeaderSize)) {
+        size_t next = 0;
+        int wrapped = 0;
+        if (std::sscanf(header, "WDOGLOG1 next=%zu wrapped=%d", &next, &wrapped) == 2 &&
+            next >= kHeaderSize && next < maxBytes) {
+            svc.next = next;
+            svc.wrapped = wrapped != 0;
+            resume = true;
+        }
+    }
+    if (!resume && (ftruncate(svc.fileFd, 0) < 0 || ftruncate(svc.fileFd, static_cast<off_t>(maxBytes)) < 0)) {
+        return false;
+    }
+    // Reserve the blocks now, so a full disk shows up here and not as lost output later
+    if (fallocate(svc.fileFd, 0, 0, static_cast<off_t>(maxBytes)) < 0 && errno != EOPNOTSUPP) {
+        logToWindowsEventLog("Cannot preallocate log file " + svc.file + ": " + std::strerror(errno), WDOG_LOG_WARNING);
+    }
+    // The first header goes through write(2), so its block exists before it is updated through the mapping
+    formatHeader(header, svc.next, svc.wrapped);
+    if (pwrite(svc.fileFd, header, kHeaderSize, 0) != static_cast<ssize_t>(kHeaderSize)) return false;
+    void* map = mmap(nullptr, maxBytes, PROT_READ | PROT_WRITE, MAP_SHARED, svc.fileFd, 0);
+    if (map == MAP_FAILED) return false;
+    svc.map = static_cast<char*>(map);
+    return true;
+}
+
+bool OutputCapture::addService(const std::string& service) {
+    if (dirFd < 0) return false;
+    if (hasService(service)) return true;
+    Service svc;
+    svc.name = service;
+    svc.file = logFileName(service);
+    // Two services writing one ring would overwrite each other's output, also while a removed one drains
+    for (const auto& other : services) {
+        if (other.second.file != svc.file) continue;
+        logToWindowsEventLog("Cannot capture the output of " + service + ": " + svc.file + " is already the log of " +
+                             other.first, WDOG_LOG_WARNING);
+        return false;
+    }
+    for (const auto& other : retired) {
+        if (other.second.file != svc.file) continue;
+        logToWindowsEventLog("Cannot capture the output of " + service + ": " + svc.file + " is still the log of " +
+                             other.second.name + ", which was removed", WDOG_LOG_WARNING);
+        return false;
+    }
+    int fds[2] = { -1, -1 };
+    if (!openLog(svc) || pipe2(fds, O_CLOEXEC) < 0) {
+        logToWindowsEventLog("Cannot capture the output of " + service + " in " + dirPath + "/" + svc.file + ": " +
+                             std::strerror(errno), WDOG_LOG_WARNING);
+        closeService(svc);
+        return false;
+    }
+    svc.readFd = fds[0];
+    svc.writeFd = fds[1];
+    // Only our end is non-blocking; the services write to a normal, blocking pipe
+    fcntl(svc.readFd, F_SETFL, O_NONBLOCK);
+    fcntl(svc.readFd, F_SETPIPE_SZ, kPipeSize); // best effort
+    pipes[svc.readFd] = service;
+    services[service] = svc;
+    return true;
+}
+
+void OutputCapture::removeService(const std::string& service) {
+    auto it = services.find(service);
+    if (it == services.end()) return;
+    Service svc = it->second;
+    services.erase(it);
+    pipes.erase(svc.readFd);
+    close(svc.writeFd);
+    svc.writeFd = -1;
+    // Without our copy of the write end, the pipe reports end of file once its last writer is gone
+    if (drainPipe(svc)) {
+        closeService(svc);
+    } else {
+        retired[svc.readFd] = svc;
+    }
+}
+
+std::vector<std::string> OutputCapture::serviceNames() const {
+    std::vector<std::string> names;
+    for (const auto& s : services) names.push_back(s.first);
+    return names;
+}
+
+int OutputCapture::outputFd(const std::string& service) const {
+    auto it = services.find(service);
+    return it == services.end() ? -1 : it->second.writeFd;
+}
+
+int OutputCapture::pipeFd(const std::string& service) const {
+    auto it = services.find(service);
+    return it == services.end() ? -1 : it->second.readFd;
+}
+
+void OutputCapture::drain(int pipeFd) {
+    auto it = pipes.find(pipeFd);
+    if (it != pipes.end()) {
+        drainPipe(services[it->second]);
+        return;
+    }
+    auto old = retired.find(pipeFd);
+    if (old != retired.end() && drainPipe(old->second)) {
+        closeService(old->second);
+        retired.erase(old);
+    }
+}
+
+void OutputCapture::drainService(const std::string& service) {
+    auto it = services.find(service);
+    if (it != services.end()) drainPipe(it->second);
+}
+
+// Helper: Account for bytes written at svc.next, wrapping around at the end of the file
+void OutputCapture::advance(Service& svc, size_t bytes) {
+    svc.next += bytes;
+    if (svc.next >= svc.size) {
+        svc.next = kHeaderSize;
+        svc.wrapped = true;
+    }
+}
+
+void OutputCapture::writeFailed(Service& svc, int error) {
+    if (svc.failing) return;
+    svc.failing = true;
+    logToWindowsEventLog("Cannot write the log of " + svc.name + " (" + std::strerror(error) +
+                         "), discarding its output", WDOG_LOG_WARNING);
+}
+
+// Splices everything the pipe holds into the log file. Returns true once the pipe has no writers left
+bool OutputCapture::drainPipe(Service& svc) {
+    if (!spliceUsable || svc.failing) return copyPipe(svc);
+    bool moved = false;
+    bool eof = false;
+    while (true) {
+        loff_t offset = static_cast<loff_t>(svc.next);
+        ssize_t n = splice(svc.readFd, nullptr, svc.fileFd, &offset, svc.size - svc.next,
+                           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n > 0) {
+            advance(svc, static_cast<size_t>(n));
+            moved = true;
+            continue;
+        }
+        if (n == 0) {
+            eof = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EINVAL) {
+            // The file system of the log directory cannot splice; copy from now on
+            logToWindowsEventLog("Log directory " + dirPath + " does not support splice, copying output instead",
+                                 WDOG_LOG_WARNING);
+            spliceUsable = false;
+            eof = copyPipe(svc);
+        } else if (errno != EAGAIN) {
+            writeFailed(svc, errno);
+            eof = copyPipe(svc);
+        }
+        break;
+    }
+    if (moved) formatHeader(svc.map, svc.next, svc.wrapped);
+    return eof;
+}
+
+// Reads the pipe and writes it to the log file with pwrite, or discards it if writing failed before, so
+// the event loop is not woken again and again by a pipe nobody empties. Returns true at end of file
+bool OutputCapture::copyPipe(Service& svc) {
+    static char buffer[64 * 1024];
+    bool moved = false;
+    while (true) {
+        ssize_t n = read(svc.readFd, buffer, sizeof(buffer));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) break;
+        if (n == 0) return true;
+        for (size_t done = 0; done < static_cast<size_t>(n) && !svc.failing;) {
+            size_t chunk = std::min(static_cast<size_t>(n) - done, svc.size - svc.next);
+            ssize_t written = pwrite(svc.fileFd, buffer + done, chunk, static_cast<off_t>(svc.next));
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                writeFailed(svc, written < 0 ? errno : ENOSPC);
+                break;
+            }
+            advance(svc, static_cast<size_t>(written));
+            done += static_cast<size_t>(written);
+            moved = true;
+        }
+    }
+    if (moved) formatHeader(svc.map, svc.next, svc.wrapped);
+    return false;
+}
+
+std::string OutputCapture::tail(const std::string& service) const {
+    auto it = services.find(service);
+    if (it == services.end() || tailBytes == 0) return std::string();
+    const Service& svc = it->second;
+    const size_t dataSize = svc.size - kHeaderSize;
+    const size_t end = svc.next - kHeaderSize; // in the data area
+    const size_t available = svc.wrapped ? dataSize : end;
+    const size_t length = std::min(tailBytes, available);
+    const char* data = svc.map + kHeaderSize;
+    std::string text;
+    text.reserve(length);
+    size_t start = (end + dataSize - length) % dataSize;
+    if (start + length <= dataSize) {
+        text.append(data + start, length);
+    } else {
+        text.append(data + start, dataSize - start);
+        text.append(data, length - (dataSize - start));
+    }
+    // Drop the partial first line if something precedes it
+    if (length < available) {
+        size_t newline = text.find('\n');
+        if (newline != std::string::npos && newline + 1 < text.size()) text.erase(0, newline + 1);
+    }
+    return text;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <sys/types.h>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Captures stdout and stderr of managed services into one size-capped ring log file per service
+// ("log_dir"), so their output no longer mixes with the watchdog's own log lines.
+// Every service has a pipe that all of its processes (and restarts) write to. The watchdog drains it
+// with splice(2) straight into the log file, so the bytes never pass through user space, and keeps
+// the file mapped, so the last lines of a service can be read without any I/O.
+class OutputCapture {
+public:
+    // Bytes at the start of every log file holding the write position (see OutputCapture.cpp)
+    static const size_t kHeaderSize = 64;
+
+    OutputCapture() = default;
+    ~OutputCapture();
+    OutputCapture(const OutputCapture&) = delete;
+    OutputCapture& operator=(const OutputCapture&) = delete;
+
+    // Creates (if needed) the log directory. maxBytes is the size of each log file, tailBytes how much of
+    // the latest output tail() returns. Safe to call again with the same values; anything else reopens
+    // all logs. Returns false if the directory cannot be used
+    bool init(const std::string& dir, size_t maxBytes, size_t tailBytes);
+    bool isReady() const { return dirFd >= 0; }
+
+    // Opens the log file of a service (continuing where a previous run left it) and its pipe
+    bool addService(const std::string& service);
+    // Stops capturing for a service. Processes still running keep their stdout: the pipe is drained into
+    // the log file until the last of them has exited
+    void removeService(const std::string& service);
+    bool hasService(const std::string& service) const { return services.count(service) > 0; }
+    std::vector<std::string> serviceNames() const;
+
+    // Write end of the service's pipe, to become stdout and stderr of its processes, or -1
+    int outputFd(const std::string& service) const;
+    // Read end of the service's pipe, to watch for readability, or -1
+    int pipeFd(const std::string& service) const;
+
+    // Moves everything buffered in a pipe (given by its read end) into its log file. The pipe of a
+    // removed service is closed, and thereby leaves the event loop, once no process writes to it any more
+    void drain(int pipeFd);
+    void drainService(const std::string& service);
+
+    // The latest output of the service, at most tailBytes, starting at a line boundary when possible
+    std::string tail(const std::string& service) const;
+private:
+    struct Service {
+        std::string name;   // of the service, for messages
+        std::string file;   // file name in the log directory
+        int readFd = -1;
+        int writeFd = -1;
+        int fileFd = -1;
+        char* map = nullptr;       // the whole log file, shared with the page cache
+        size_t size = 0;           // of the log file
+        size_t next = kHeaderSize; // where the next byte goes
+        bool wrapped = false;      // the data area has been filled at least once
+        bool failing = false;      // writing failed; the error was logged once
+    };
+
+    bool openLog(Service& svc);
+    bool drainPipe(Service& svc);
+    bool copyPipe(Service& svc);
+    void advance(Service& svc, size_t bytes);
+    void writeFailed(Service& svc, int error);
+    void closeService(Service& svc);
+    void clear();
+
+    std::string dirPath;
+    int dirFd = -1;
+    size_t maxBytes = 0;
+    size_t tailBytes = 0;
+    bool spliceUsable = true; // false once the log file system turned out not to support splice
+    std::unordered_map<std::string, Service> services;
+    std::unordered_map<int, std::string> pipes; // read end -> service
+    std::unordered_map<int, Service> retired;   // read end -> removed service still being written to
+};
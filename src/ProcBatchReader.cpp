@@ -0,0 +1,297 @@
+/*
+    ProcBatchReader.cpp - Batched reads of per-PID /proc files through io_uring
+
+    Even with stack buffers and a persistent /proc fd, every PID of a scan costs three system calls
+    (openat, read, close), issued strictly one after another. With 100k PIDs that is 300k kernel
+    entries per scan. io_uring lets us queue those operations in shared memory and hand a whole batch
+    to the kernel with one io_uring_enter:
+
+    1. openat for every PID of the batch, submitted together; the CQEs carry the new fds
+    2. read for every opened file, submitted together, into one buffer per PID
+    3. close for every fd, submitted without waiting; the completions are reaped with the next batch
+
+    so a batch of 256 PIDs needs 2-3 system calls instead of 768. The ring is set up with raw syscalls
+    (no liburing dependency). IORING_REGISTER_PROBE checks that the kernel supports OPENAT, READ and
+    CLOSE (5.6+). If anything is missing, or io_uring is blocked by seccomp or
+    kernel.io_uring_disabled, the reader falls back to the plain syscall loop.
+    A ring that fails later does the same for the rest of its lifetime.
+
+    Fewer system calls did not make scans much faster: the kernel still does the same path lookup,
+    open and read per PID. On a 20k-PID fake tree (tests/bench) a scan took 49-56 ms with io_uring
+    against 55-81 ms with plain syscalls on one CPU, and 68-76 ms against 69-90 ms on a multi-core
+    host, where io_uring was slower with shard threads. That is why scans only use it on request
+    ("io_uring" in config.json).
+*/
+
+#include "ProcBatchReader.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif
+
+// user_data of close requests, whose completions are only reaped and dropped
+static const unsigned long long kCloseTag = 1ull << 63;
+
+namespace {
+
+// Formats "<pid>/<file>" into buf
+void formatPath(char* buf, pid_t pid, const char* file) {
+    char digits[16];
+    int n = 0;
+    do {
+        digits[n++] = static_cast<char>('0' + pid % 10);
+        pid /= 10;
+    } while (pid > 0);
+    char* p = buf;
+    while (n > 0) *p++ = digits[--n];
+    *p++ = '/';
+    while (*file) *p++ = *file++;
+    *p = '\0';
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+} // namespace
+
+ProcBatchReader::ProcBatchReader(bool useUring, unsigned capacity) : slots(capacity ? capacity : 1) {
+    if (useUring && !setupRing(static_cast<unsigned>(slots.size()))) teardownRing();
+}
+
+ProcBatchReader::~ProcBatchReader() {
+    teardownRing();
+}
+
+bool ProcBatchReader::setupRing(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 2; // room for the close completions of the previous batch
+    ringFd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ringFd < 0) return false;
+
+    // Make sure the kernel knows every operation we need
+    size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    io_uring_probe* probe = static_cast<io_uring_probe*>(std::calloc(1, probeSize));
+    if (!probe) return false;
+    bool supported = syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, 256) >= 0;
+    const int ops[] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE };
+    for (int op : ops) {
+        supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    std::free(probe);
+    if (!supported) return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single && cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        return false;
+    }
+    if (single) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            return false;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = nullptr;
+        return false;
+    }
+
+    char* sq = static_cast<char*>(sqRing);
+    char* cq = static_cast<char*>(cqRing);
+    sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    return true;
+}
+
+void ProcBatchReader::teardownRing() {
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing) munmap(sqRing, sqRingSize);
+    sqes = sqRing = cqRing = nullptr;
+    if (ringFd >= 0) close(ringFd);
+    ringFd = -1;
+}
+
+void ProcBatchReader::read(int dirFd, const pid_t* pids, size_t count, const char* file) {
+    if (count > slots.size()) count = slots.size();
+    for (size_t i = 0; i < count; ++i) {
+        formatPath(slots[i].path, pids[i], file);
+        slots[i].fd = -1;
+        slots[i].len = -1;
+    }
+    if (ringFd >= 0) {
+        readWithUring(dirFd, count);
+    } else {
+        readWithSyscalls(dirFd, count);
+    }
+}
+
+void ProcBatchReader::readWithSyscalls(int dirFd, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        Slot& slot = slots[i];
+        if (slot.len >= 0) {
+            // Already read by the ring before it failed mid-batch; only its fd is left to close
+            if (slot.fd >= 0) close(slot.fd);
+            slot.fd = -1;
+            continue;
+        }
+        if (slot.fd < 0) slot.fd = openat(dirFd, slot.path, O_RDONLY | O_CLOEXEC);
+        if (slot.fd < 0) continue;
+        ssize_t n;
+        do {
+            n = ::read(slot.fd, slot.buf, sizeof(slot.buf));
+        } while (n < 0 && errno == EINTR);
+        slot.len = n > 0 ? n : -1;
+        close(slot.fd);
+        slot.fd = -1;
+    }
+}
+
+// Queues one SQE per slot for which prepare(sqe, i) returns true, submits them with a single
+// io_uring_enter and waits for all of their completions (stale close completions are dropped).
+// Returns false if the ring failed; the caller then finishes with plain syscalls. Even then every
+// request the kernel took is waited for first, so no open completes unseen and leaks its fd.
+template <typename Prepare>
+bool ProcBatchReader::submitAndWait(size_t count, Prepare prepare) {
+    io_uring_sqe* sqeArray = static_cast<io_uring_sqe*>(sqes);
+    io_uring_cqe* cqeArray = static_cast<io_uring_cqe*>(cqes);
+    unsigned tail = *sqTail;
+    unsigned queued = 0;
+    for (size_t i = 0; i < count; ++i) {
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqeArray[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        if (!prepare(sqe, i)) continue;
+        sqe->user_data = i;
+        sqArray[index] = index;
+        ++tail;
+        ++queued;
+    }
+    if (queued == 0) return true;
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    unsigned completed = 0;
+    bool failed = false;
+    while (completed < (failed ? submitted : queued)) {
+        // After a failure nothing more is submitted; only the requests already taken are waited for
+        unsigned toSubmit = failed ? 0 : queued - submitted;
+        int ret = uringEnter(ringFd, toSubmit, (failed ? submitted : queued) - completed, IORING_ENTER_GETEVENTS);
+        int error = errno;
+        if (ret > 0) submitted += static_cast<unsigned>(ret) < toSubmit ? static_cast<unsigned>(ret) : toSubmit;
+        unsigned head = *cqHead;
+        unsigned cqTailNow = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != cqTailNow; ++head) {
+            const io_uring_cqe& cqe = cqeArray[head & *cqMask];
+            if (cqe.user_data & kCloseTag) continue;
+            Slot& slot = slots[cqe.user_data];
+            if (slot.fd == -2) {
+                slot.fd = cqe.res;         // openat: the new fd, or -errno
+            } else {
+                slot.len = cqe.res > 0 ? cqe.res : -1;
+            }
+            ++completed;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+        if (ret < 0 && error != EINTR) {
+            if (failed) break; // cannot even wait any more: what is still in flight is lost
+            failed = true;
+        }
+    }
+    return !failed;
+}
+
+void ProcBatchReader::readWithUring(int dirFd, size_t count) {
+    // Phase 1: open everything (fd == -2 marks a pending open)
+    bool ok = submitAndWait(count, [&](io_uring_sqe* sqe, size_t i) {
+        Slot& slot = slots[i];
+        slot.fd = -2;
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = dirFd;
+        sqe->addr = reinterpret_cast<unsigned long long>(slot.path);
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        return true;
+    });
+    // Phase 2: read everything that opened
+    ok = ok && submitAndWait(count, [&](io_uring_sqe* sqe, size_t i) {
+        Slot& slot = slots[i];
+        if (slot.fd < 0) return false;
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = slot.fd;
+        sqe->addr = reinterpret_cast<unsigned long long>(slot.buf);
+        sqe->len = sizeof(slot.buf);
+        sqe->off = 0;
+        return true;
+    });
+    if (!ok) {
+        // The ring broke; finish this batch and all later ones with plain syscalls, which also close
+        // the fds of the files the ring opened (and maybe read). Opens still marked pending were never
+        // submitted
+        for (size_t i = 0; i < count; ++i) {
+            if (slots[i].fd == -2) slots[i].fd = -1;
+        }
+        teardownRing();
+        readWithSyscalls(dirFd, count);
+        return;
+    }
+
+    // Phase 3: close without waiting; submitAndWait drops these completions in the next batch
+    io_uring_sqe* sqeArray = static_cast<io_uring_sqe*>(sqes);
+    unsigned tail = *sqTail;
+    unsigned queued = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (slots[i].fd < 0) continue;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe* sqe = &sqeArray[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->fd = slots[i].fd;
+        sqe->user_data = kCloseTag | i;
+        sqArray[index] = index;
+        ++tail;
+        ++queued;
+        slots[i].fd = -1;
+    }
+    if (queued == 0) return;
+    unsigned first = *sqTail;
+    __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+    int ret;
+    while ((ret = uringEnter(ringFd, queued, 0, 0)) < 0 && errno == EINTR) {}
+    if (ret < static_cast<int>(queued)) {
+        // Close whatever the kernel did not take ourselves, then stop using the ring
+        for (unsigned t = first + (ret > 0 ? ret : 0); t != tail; ++t) close(sqeArray[t & *sqMask].fd);
+        teardownRing();
+    }
+}
@@ -0,0 +1,125 @@
+/*
+    ProcConnector.cpp - Kernel process event subscription for the Linux watchdog
+
+    The proc connector is a netlink multicast group on which the kernel announces process lifecycle
+    events. Compared to polling /proc it costs nothing while nothing happens, and exits are known the
+    moment they happen, for every process on the host rather than only for our own children.
+
+    Only process-level events are reported to the caller. Threads generate fork/exit events too
+    (their pid differs from their tgid); these are filtered out here.
+*/
+
+#include "ProcConnector.h"
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+ProcConnector::~ProcConnector() {
+    close();
+}
+
+bool ProcConnector::open() {
+    close();
+    sock = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (sock < 0) return false;
+
+    sockaddr_nl addr{};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    addr.nl_pid = 0; // let the kernel pick a unique port id
+    if (bind(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        int err = errno;
+        close();
+        errno = err;
+        return false;
+    }
+
+    // A bigger receive buffer makes ENOBUFS (lost events) less likely during fork storms
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Ask the kernel to start multicasting process events to this socket
+    // (nlmsghdr + cn_msg + proc_cn_mcast_op, laid out back to back)
+    alignas(nlmsghdr) char req[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    nlmsghdr* hdr = reinterpret_cast<nlmsghdr*>(req);
+    hdr->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    hdr->nlmsg_type = NLMSG_DONE;
+    hdr->nlmsg_pid = static_cast<__u32>(getpid());
+    cn_msg* msg = static_cast<cn_msg*>(NLMSG_DATA(hdr));
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(proc_cn_mcast_op);
+    proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    std::memcpy(msg->data, &op, sizeof(op));
+    if (send(sock, req, hdr->nlmsg_len, 0) < 0) {
+        int err = errno;
+        close();
+        errno = err;
+        return false;
+    }
+    return true;
+}
+
+void ProcConnector::close() {
+    if (sock >= 0) {
+        ::close(sock);
+        sock = -1;
+    }
+}
+
+bool ProcConnector::drain(std::vector<Event>& out) {
+    alignas(nlmsghdr) char buf[8192];
+    while (true) {
+        sockaddr_nl from{};
+        socklen_t fromLen = sizeof(from);
+        ssize_t len = recvfrom(sock, buf, sizeof(buf), 0, reinterpret_cast<sockaddr*>(&from), &fromLen);
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) return false;
+            return true; // EAGAIN: nothing left to read
+        }
+        if (from.nl_pid != 0) continue; // only trust messages sent by the kernel
+
+        for (nlmsghdr* nlh = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(nlh, static_cast<unsigned>(len));
+             nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_ERROR || nlh->nlmsg_type == NLMSG_NOOP) continue;
+            const cn_msg* msg = static_cast<const cn_msg*>(NLMSG_DATA(nlh));
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC) continue;
+            const proc_event* ev = reinterpret_cast<const proc_event*>(msg->data);
+
+            Event e{};
+            switch (ev->what) {
+                case proc_event::PROC_EVENT_FORK:
+                    if (ev->event_data.fork.child_pid != ev->event_data.fork.child_tgid) continue; // new thread
+                    e.type = Event::Fork;
+                    e.pid = ev->event_data.fork.child_tgid;
+                    e.parentPid = ev->event_data.fork.parent_tgid;
+                    break;
+                case proc_event::PROC_EVENT_EXEC:
+                    e.type = Event::Exec;
+                    e.pid = ev->event_data.exec.process_tgid;
+                    break;
+                case proc_event::PROC_EVENT_COMM:
+                    // prctl(PR_SET_NAME) from a secondary thread only renames that thread
+                    if (ev->event_data.comm.process_pid != ev->event_data.comm.process_tgid) continue;
+                    e.type = Event::Comm;
+                    e.pid = ev->event_data.comm.process_tgid;
+                    std::memcpy(e.comm, ev->event_data.comm.comm, sizeof(e.comm));
+                    e.comm[sizeof(e.comm) - 1] = '\0';
+                    break;
+                case proc_event::PROC_EVENT_EXIT:
+                    if (ev->event_data.exit.process_pid != ev->event_data.exit.process_tgid) continue; // thread exit
+                    e.type = Event::Exit;
+                    e.pid = ev->event_data.exit.process_tgid;
+                    break;
+                default:
+                    continue;
+            }
+            out.push_back(e);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <sys/types.h>
+#include <string>
+#include <vector>
+
+// Subscriber to the kernel proc connector (NETLINK_CONNECTOR / CN_IDX_PROC).
+// The kernel multicasts an event for every fork, exec, comm change and exit on the host,
+// which lets LinuxApiWrapper keep its name -> PID index current without scanning /proc.
+// Subscribing requires CAP_NET_ADMIN; open() fails otherwise and the caller falls back to scanning.
+class ProcConnector {
+public:
+    struct Event {
+        enum Type { Fork, Exec, Comm, Exit };
+        Type type;
+        pid_t pid;       // process (thread group) the event is about
+        pid_t parentPid; // Fork only: the process that forked
+        char comm[16];   // Comm only: the new name
+    };
+
+    ProcConnector() = default;
+    ~ProcConnector();
+    ProcConnector(const ProcConnector&) = delete;
+    ProcConnector& operator=(const ProcConnector&) = delete;
+
+    // Opens the netlink socket and subscribes to process events. Returns false (with errno set)
+    // if the socket cannot be opened or bound, typically EPERM for unprivileged processes.
+    bool open();
+    void close();
+    bool isOpen() const { return sock >= 0; }
+    int fd() const { return sock; }
+
+    // Reads every pending message without blocking and appends the process-level events to out.
+    // Returns false if the kernel dropped messages because our receive buffer overflowed (ENOBUFS);
+    // the caller must then resynchronise with a full scan.
+    bool drain(std::vector<Event>& out);
+private:
+    int sock = -1;
+};
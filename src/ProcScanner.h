@@ -0,0 +1,98 @@
+#pragma once
+#include "ProcBatchReader.h"
+#include <sys/types.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// One process found by a /proc scan
+struct ProcEntry {
+    pid_t pid;
+    char comm[16]; // NUL-terminated contents of /proc/[pid]/comm (the kernel caps it at 15 bytes)
+};
+
+// Changes to the process table since the previous incremental scan
+struct ProcDelta {
+    std::vector<ProcEntry> appeared; // new processes, and PIDs reused or renamed since the last scan
+    std::vector<pid_t> disappeared;  // processes that exited (or whose PID was reused or renamed)
+};
+
+// Low-level /proc scanner. It keeps one directory fd on the procfs root open for its whole lifetime, lists it with
+// getdents64 and reads the per-PID files in batches through ProcBatchReader (io_uring where available),
+// so a scan makes no heap allocation per PID (the output vector keeps its capacity between scans).
+class ProcScanner {
+public:
+    // root is the procfs to read, normally /proc; containers or benchmark fixtures may use another one
+    explicit ProcScanner(const std::string& root = "/proc");
+    ~ProcScanner();
+    ProcScanner(const ProcScanner&) = delete;
+    ProcScanner& operator=(const ProcScanner&) = delete;
+
+    // Replaces the contents of out with every process currently listed in /proc.
+    // Returns false if /proc could not be read at all.
+    bool scan(std::vector<ProcEntry>& out);
+
+    // Scans /proc against the cache of processes seen by previous incremental scans and reports only
+    // what changed. A cached PID is validated by its start time from /proc/[pid]/stat, so a PID that
+    // was reused by a new process between two scans is reported as disappeared and appeared again.
+    // Every PID still costs one read of its stat file, changed or not.
+    // Returns false if /proc could not be read; the cache is left untouched in that case.
+    bool scanIncremental(ProcDelta& delta);
+
+    // Switches to another procfs root and forgets the cache. Returns false if it cannot be opened,
+    // in which case every scan fails until a usable root is set.
+    bool setRoot(const std::string& root);
+    const std::string& getRoot() const { return rootPath; }
+
+    // Forgets every cached process, so the next incremental scan reports all of them as appeared
+    void clearCache() { cache.clear(); }
+
+    // Number of threads incremental scans may use (1 = scan on the calling thread only, 0 = one per
+    // CPU). On large hosts the PID list is split into shards that are read in parallel; small process
+    // tables are always scanned on the calling thread.
+    void setThreads(unsigned threads);
+
+    // Whether per-PID files are read in io_uring batches or with one openat/read/close per PID (the
+    // default). Batched reads fall back to the latter by themselves where io_uring is unavailable.
+    void setBatchedReads(bool enabled);
+    // Whether scans currently go through io_uring
+    bool usesUring();
+
+    // Reads /proc/[pid]/comm of a single process into comm. Returns false if the process is gone.
+    bool readComm(pid_t pid, char (&comm)[16]) const;
+
+    // Resolves the full name of a process whose comm may have been cut off at 15 bytes: the file name of
+    // /proc/[pid]/exe, or else of argv[0] from /proc/[pid]/cmdline, whichever starts with comm.
+    // Returns false (leaving name alone) if neither does or the process is gone.
+    bool readLongName(pid_t pid, const char* comm, std::string& name) const;
+private:
+    struct CachedProc {
+        unsigned long long startTime; // clock ticks after boot, field 22 of /proc/[pid]/stat
+        char comm[16];
+        unsigned generation;          // last incremental scan that saw the process
+    };
+
+    // What one shard of an incremental scan found. Shards only touch their own cache entries
+    // (no insertion or removal), so they run without locks and are merged afterwards
+    struct ShardResult {
+        ProcDelta delta;
+        std::vector<std::pair<pid_t, CachedProc>> inserts; // PIDs missing from the cache
+    };
+    class WorkerPool;
+
+    void scanShard(size_t begin, size_t end, ShardResult& out, ProcBatchReader& reader);
+    void ensureReaders(size_t count);
+
+    std::string rootPath;
+    int procFd = -1;
+    std::unordered_map<pid_t, CachedProc> cache;
+    unsigned generation = 0;
+    std::vector<pid_t> listed; // reused PID list of the current scan
+    std::vector<ShardResult> shards;
+    std::unique_ptr<WorkerPool> pool;
+    bool batchedReads = false;
+    std::vector<std::unique_ptr<ProcBatchReader>> readers; // one per shard, each owning its own ring
+};
@@ -1,14 +1,211 @@
 #pragma once
 #include <string>
+#include <vector>
+
+// How the configured name of a process is compared with the names of running processes
+enum class MatchKind {
+    Exact, // the name itself, e.g. "nginx"
+    Glob,  // shell-style wildcards, e.g. "worker-*"
+    Regex  // a regular expression that must match the whole name, e.g. "worker-[0-9]+"
+};
+
+// When an entry that stopped is started again ("restart")
+enum class RestartPolicy {
+    Always,   // whenever it is not running
+    OnFailure // unless it exited with status 0
+};
 
 class ProcessInfo {
 public:
-    ProcessInfo() : name(""), args("") {} 
+    ProcessInfo() : name(""), args(""), match(MatchKind::Exact), exe("") { tokenizeArgs(); }
     ProcessInfo(const std::string& name, const std::string& args)
-        : name(name), args(args) {}
+        : name(name), args(args), match(MatchKind::Exact), exe("") { tokenizeArgs(); }
+    ProcessInfo(const std::string& name, const std::string& args, MatchKind match, const std::string& exe)
+        : name(name), args(args), match(match), exe(exe) { tokenizeArgs(); }
+
+    // argv points into argBlock, so copies re-point it at their own block. Moves keep the buffer.
+    ProcessInfo(const ProcessInfo& other)
+        : name(other.name), args(other.args), match(other.match), exe(other.exe), cgroup(other.cgroup),
+          restart(other.restart), dependsOn(other.dependsOn), listen(other.listen), fdStore(other.fdStore),
+          standby(other.standby), readahead(other.readahead), argBlock(other.argBlock) {
+        indexArgv();
+    }
+    ProcessInfo& operator=(const ProcessInfo& other) {
+        if (this != &other) {
+            name = other.name;
+            args = other.args;
+            match = other.match;
+            exe = other.exe;
+            cgroup = other.cgroup;
+            restart = other.restart;
+            dependsOn = other.dependsOn;
+            listen = other.listen;
+            fdStore = other.fdStore;
+            standby = other.standby;
+            readahead = other.readahead;
+            argBlock = other.argBlock;
+            indexArgv();
+        }
+        return *this;
+    }
+    ProcessInfo(ProcessInfo&&) = default;
+    ProcessInfo& operator=(ProcessInfo&&) = default;
+
     std::string getName() const { return name; }
+    // Arguments as one command line string (what Windows passes to CreateProcess)
     std::string getArgs() const { return args; }
+    MatchKind getMatchKind() const { return match; }
+    // Executable to launch when nothing matches. Exact entries default to their name;
+    // pattern entries without an explicit "exe" are only watched, never launched.
+    std::string getExe() const { return exe.empty() && match == MatchKind::Exact ? name : exe; }
+    // Whether the entry is started into its own cgroup and judged alive by that cgroup (Linux, "cgroup")
+    bool usesCgroup() const { return cgroup; }
+    void setUseCgroup(bool value) { cgroup = value; }
+    RestartPolicy getRestartPolicy() const { return restart; }
+    void setRestartPolicy(RestartPolicy policy) { restart = policy; }
+    // Names of the entries that must be running before this one is started ("depends_on")
+    const std::vector<std::string>& getDependsOn() const { return dependsOn; }
+    void setDependsOn(const std::vector<std::string>& names) { dependsOn = names; }
+    // Addresses the watchdog listens on for the entry and passes to its processes (Linux, "listen")
+    const std::vector<std::string>& getListen() const { return listen; }
+    void setListen(const std::vector<std::string>& addresses) { listen = addresses; }
+    // Most fds the entry's processes may hand to the watchdog for their successors, 0 = none (Linux, "fd_store")
+    unsigned getFdStore() const { return fdStore; }
+    void setFdStore(unsigned count) { fdStore = count; }
+    // Idle instances kept started to take over when the active one exits (Linux, "standby")
+    unsigned getStandby() const { return standby; }
+    void setStandby(unsigned count) { standby = count; }
+    // Whether the executable and its libraries are read into the page cache before restarts (Linux, "readahead")
+    bool usesReadahead() const { return readahead; }
+    void setReadahead(bool value) { readahead = value; }
+
+    // Ready-to-exec argument vector: getExe() followed by the arguments, NULL-terminated.
+    // It is tokenized once, when the entry is created, and kept in one contiguous block.
+    char* const* getArgv() const { return argv.data(); }
+    size_t getArgc() const { return argv.empty() ? 0 : argv.size() - 1; }
+
+    // Replaces the arguments with an explicit list (a JSON "args" array); getArgs() becomes the
+    // quoted command line for them, in the quoting of the platform's own parser
+    void setArgv(const std::vector<std::string>& list) {
+        args.clear();
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i > 0) args += ' ';
+#ifdef _WIN32
+            args += quoteWindowsArg(list[i]);
+#else
+            args += quoteArg(list[i]);
+#endif
+        }
+        buildArgv(list);
+    }
+
+    // Quotes a word so that the Windows command line parser (CommandLineToArgvW and the C runtime) reads it
+    // back: backslashes are literal except in front of a '"', so only those, and the ones before the closing
+    // quote, are doubled, and '"' itself becomes \"
+    static std::string quoteWindowsArg(const std::string& word) {
+        if (!word.empty() && word.find_first_of(" \t\n\v\"") == std::string::npos) return word;
+        std::string quoted = "\"";
+        size_t backslashes = 0;
+        for (size_t i = 0; i < word.size(); ++i) {
+            if (word[i] == '\\') {
+                ++backslashes;
+                continue;
+            }
+            quoted.append(word[i] == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+            quoted += word[i];
+            backslashes = 0;
+        }
+        quoted.append(backslashes * 2, '\\');
+        return quoted + "\"";
+    }
+
+    // Splits a command line into words like a POSIX shell, without any expansion: whitespace separates
+    // words, '...' is taken literally, "..." honours the escapes \" \\ \$ \` and a backslash elsewhere
+    // escapes the next character. Returns false if a quote is left open (the rest becomes the last word).
+    static bool splitCommandLine(const std::string& line, std::vector<std::string>& words) {
+        words.clear();
+        std::string word;
+        bool inWord = false;
+        char quote = 0;
+        for (size_t i = 0; i < line.size(); ++i) {
+            char c = line[i];
+            if (quote == '\'') {
+                if (c == '\'') quote = 0; else word += c;
+            } else if (quote == '"') {
+                if (c == '"') {
+                    quote = 0;
+                } else if (c == '\\' && i + 1 < line.size() &&
+                           (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$' || line[i + 1] == '`')) {
+                    word += line[++i];
+                } else {
+                    word += c;
+                }
+            } else if (c == ' ' || c == '\t' || c == '\n') {
+                if (inWord) words.push_back(word);
+                word.clear();
+                inWord = false;
+            } else {
+                inWord = true;
+                if (c == '\'' || c == '"') quote = c;
+                else if (c == '\\' && i + 1 < line.size()) word += line[++i];
+                else word += c;
+            }
+        }
+        if (inWord) words.push_back(word);
+        return quote == 0;
+    }
 private:
+    // Helper: Quote a word so that splitCommandLine reads it back
+    static std::string quoteArg(const std::string& word) {
+        if (!word.empty() && word.find_first_of(" \t\n\"'\\$`") == std::string::npos) return word;
+        std::string quoted = "\"";
+        for (size_t i = 0; i < word.size(); ++i) {
+            if (word[i] == '"' || word[i] == '\\' || word[i] == '$' || word[i] == '`') quoted += '\\';
+            quoted += word[i];
+        }
+        return quoted + "\"";
+    }
+
+    void tokenizeArgs() {
+        std::vector<std::string> words;
+        splitCommandLine(args, words);
+        buildArgv(words);
+    }
+
+    // Lays out getExe() and the arguments as "exe\0arg1\0arg2\0" and points argv at them
+    void buildArgv(const std::vector<std::string>& list) {
+        std::string file = getExe();
+        argBlock.assign(file.begin(), file.end());
+        argBlock.push_back('\0');
+        for (size_t i = 0; i < list.size(); ++i) {
+            argBlock.insert(argBlock.end(), list[i].begin(), list[i].end());
+            argBlock.push_back('\0');
+        }
+        indexArgv();
+    }
+
+    void indexArgv() {
+        argv.clear();
+        size_t start = 0;
+        for (size_t i = 0; i < argBlock.size(); ++i) {
+            if (argBlock[i] != '\0') continue;
+            argv.push_back(&argBlock[start]);
+            start = i + 1;
+        }
+        argv.push_back(nullptr);
+    }
+
     std::string name;
     std::string args;
-};
\ No newline at end of file
+    MatchKind match;
+    std::string exe;
+    bool cgroup = false;
+    RestartPolicy restart = RestartPolicy::Always;
+    std::vector<std::string> dependsOn;
+    std::vector<std::string> listen;
+    unsigned fdStore = 0;
+    unsigned standby = 0;
+    bool readahead = false;
+    std::vector<char> argBlock; // getExe() and the arguments, each NUL-terminated
+    std::vector<char*> argv;    // pointers into argBlock, NULL-terminated
+};
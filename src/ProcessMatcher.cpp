@@ -0,0 +1,586 @@
+/*
+    ProcessMatcher.cpp - Matching process names against thousands of config entries at once
+
+    A naive matcher compares every process name with every monitored entry, which is
+    O(processes x entries) per scan and becomes the bottleneck once the config lists thousands of
+    services or uses patterns to supervise whole families of workers ("worker-*").
+
+    How the patterns are compiled
+    -----------------------------
+    1. Each glob or regex is parsed into a small syntax tree (sets of bytes, concatenation,
+       alternation and repetition). Globs support '*', '?', '[a-z]', '[!a-z]' and '\' escapes.
+       Regexes support literals, '.', classes, '\d \w \s', groups, '|', '*', '+', '?' and {n,m},
+       and must match the whole name (leading '^' and trailing '$' are accepted and ignored).
+    2. All trees are turned into one Thompson NFA whose accepting states remember their rule.
+    3. Bytes that no pattern can tell apart are grouped into classes, which keeps the tables small.
+    4. The NFA is determinised (subset construction) into a DFA. If that would exceed
+       kMaxDfaStates, the NFA is kept and simulated instead, which is slower but bounded.
+
+    Regexes that use anything else (back-references, lookarounds, POSIX classes, ...) cannot be
+    expressed as a DFA and are matched with std::regex individually.
+*/
+
+#include "ProcessMatcher.h"
+#include "Logger.h"
+#include <algorithm>
+#include <map>
+
+namespace {
+
+typedef std::bitset<256> ByteSet;
+typedef ProcessMatcher::NfaState NfaState;
+
+const size_t kMaxDfaStates = 4096;
+const int kMaxRepeat = 100; // upper bound for {n,m} counts, which are expanded into copies
+
+// Syntax tree shared by globs and regexes
+struct Ast {
+    enum Kind { Set, Concat, Alt, Repeat };
+    Kind kind = Concat; // an empty Concat matches the empty string
+    ByteSet set;
+    std::vector<Ast> children;
+    int min = 0;
+    int max = 0; // Repeat only; -1 means unbounded
+};
+
+Ast makeSet(const ByteSet& set) {
+    Ast a;
+    a.kind = Ast::Set;
+    a.set = set;
+    return a;
+}
+
+Ast makeChar(unsigned char c) {
+    ByteSet set;
+    set.set(c);
+    return makeSet(set);
+}
+
+Ast makeRepeat(const Ast& child, int min, int max) {
+    Ast a;
+    a.kind = Ast::Repeat;
+    a.children.push_back(child);
+    a.min = min;
+    a.max = max;
+    return a;
+}
+
+ByteSet allBytes() {
+    ByteSet set;
+    set.set();
+    return set;
+}
+
+// Parses a glob into a syntax tree. Globs cannot fail: an unterminated '[' is a literal.
+Ast parseGlob(const std::string& s) {
+    Ast out;
+    for (size_t i = 0; i < s.size(); ++i) {
+        char c = s[i];
+        if (c == '*') {
+            out.children.push_back(makeRepeat(makeSet(allBytes()), 0, -1));
+        } else if (c == '?') {
+            out.children.push_back(makeSet(allBytes()));
+        } else if (c == '\\' && i + 1 < s.size()) {
+            out.children.push_back(makeChar(static_cast<unsigned char>(s[++i])));
+        } else if (c == '[' && s.find(']', i + 2) != std::string::npos) {
+            size_t j = i + 1;
+            bool negate = s[j] == '!' || s[j] == '^';
+            if (negate) ++j;
+            ByteSet set;
+            bool first = true;
+            for (; j < s.size() && (first || s[j] != ']'); ++j, first = false) {
+                unsigned char lo = static_cast<unsigned char>(s[j]);
+                unsigned char hi = lo;
+                if (j + 2 < s.size() && s[j + 1] == '-' && s[j + 2] != ']') {
+                    hi = static_cast<unsigned char>(s[j + 2]);
+                    j += 2;
+                }
+                for (unsigned b = lo; b <= hi; ++b) set.set(b);
+            }
+            if (j >= s.size()) { // no closing bracket after all: treat '[' literally
+                out.children.push_back(makeChar('['));
+                continue;
+            }
+            if (negate) set.flip();
+            out.children.push_back(makeSet(set));
+            i = j;
+        } else {
+            out.children.push_back(makeChar(static_cast<unsigned char>(c)));
+        }
+    }
+    return out;
+}
+
+// Recursive-descent parser for the regex subset described at the top of this file.
+// parse() returns false for anything outside that subset.
+class RegexParser {
+public:
+    explicit RegexParser(const std::string& s) : s(s) {}
+
+    bool parse(Ast& out) {
+        pos = 0;
+        if (!s.empty() && s[0] == '^') ++pos;
+        if (!parseAlt(out)) return false;
+        return pos == s.size();
+    }
+private:
+    const std::string& s;
+    size_t pos = 0;
+
+    bool atEnd() const { return pos >= s.size(); }
+
+    bool parseAlt(Ast& out) {
+        Ast branch;
+        if (!parseConcat(branch)) return false;
+        if (atEnd() || s[pos] != '|') {
+            out = branch;
+            return true;
+        }
+        out = Ast();
+        out.kind = Ast::Alt;
+        out.children.push_back(branch);
+        while (!atEnd() && s[pos] == '|') {
+            ++pos;
+            Ast next;
+            if (!parseConcat(next)) return false;
+            out.children.push_back(next);
+        }
+        return true;
+    }
+
+    bool parseConcat(Ast& out) {
+        out = Ast();
+        while (!atEnd() && s[pos] != '|' && s[pos] != ')') {
+            if (s[pos] == '$' && pos + 1 == s.size()) { // trailing anchor: full-match semantics anyway
+                ++pos;
+                break;
+            }
+            Ast item;
+            if (!parseRepeat(item)) return false;
+            out.children.push_back(item);
+        }
+        return true;
+    }
+
+    bool parseRepeat(Ast& out) {
+        if (!parseAtom(out)) return false;
+        while (!atEnd()) {
+            int min, max;
+            char c = s[pos];
+            if (c == '*') { min = 0; max = -1; ++pos; }
+            else if (c == '+') { min = 1; max = -1; ++pos; }
+            else if (c == '?') { min = 0; max = 1; ++pos; }
+            else if (c == '{') { if (!parseBounds(min, max)) return false; }
+            else break;
+            // A lazy suffix ("*?") is parsed as an optional repetition, which accepts the same names
+            out = makeRepeat(out, min, max);
+        }
+        return true;
+    }
+
+    bool parseNumber(int& n) {
+        if (atEnd() || s[pos] < '0' || s[pos] > '9') return false;
+        n = 0;
+        while (!atEnd() && s[pos] >= '0' && s[pos] <= '9') {
+            n = n * 10 + (s[pos++] - '0');
+            if (n > kMaxRepeat) return false;
+        }
+        return true;
+    }
+
+    bool parseBounds(int& min, int& max) {
+        ++pos; // '{'
+        if (!parseNumber(min)) return false;
+        max = min;
+        if (!atEnd() && s[pos] == ',') {
+            ++pos;
+            max = -1;
+            if (!atEnd() && s[pos] != '}' && !parseNumber(max)) return false;
+        }
+        if (atEnd() || s[pos] != '}') return false;
+        ++pos;
+        return max < 0 || max >= min;
+    }
+
+    // Shorthand classes and escaped characters shared by atoms and bracket expressions
+    bool parseEscape(ByteSet& set) {
+        if (atEnd()) return false;
+        char c = s[pos++];
+        switch (c) {
+            case 'd': case 'D':
+                for (unsigned b = '0'; b <= '9'; ++b) set.set(b);
+                break;
+            case 'w': case 'W':
+                for (unsigned b = 0; b < 256; ++b) {
+                    if ((b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || (b >= '0' && b <= '9') || b == '_')
+                        set.set(b);
+                }
+                break;
+            case 's': case 'S':
+                for (const char* ws = " \t\n\r\f\v"; *ws; ++ws) set.set(static_cast<unsigned char>(*ws));
+                break;
+            case 'n': set.set('\n'); return true;
+            case 't': set.set('\t'); return true;
+            case 'r': set.set('\r'); return true;
+            case 'f': set.set('\f'); return true;
+            case 'v': set.set('\v'); return true;
+            default:
+                // Back-references, word boundaries, hex/unicode escapes etc. are not supported
+                if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) return false;
+                set.set(static_cast<unsigned char>(c));
+                return true;
+        }
+        if (c >= 'A' && c <= 'Z') set.flip(); // \D \W \S
+        return true;
+    }
+
+    bool parseClass(Ast& out) {
+        bool negate = !atEnd() && s[pos] == '^';
+        if (negate) ++pos;
+        ByteSet set;
+        bool first = true;
+        while (!atEnd() && (first || s[pos] != ']')) {
+            first = false;
+            if (s.compare(pos, 2, "[:") == 0 || s.compare(pos, 2, "[=") == 0 || s.compare(pos, 2, "[.") == 0) {
+                return false; // POSIX classes
+            }
+            ByteSet item;
+            unsigned char lo;
+            if (s[pos] == '\\') {
+                ++pos;
+                if (!parseEscape(item)) return false;
+                if (item.count() != 1) { // a shorthand class cannot start a range
+                    set |= item;
+                    continue;
+                }
+                lo = 0;
+                while (!item.test(lo)) ++lo;
+            } else {
+                lo = static_cast<unsigned char>(s[pos++]);
+            }
+            unsigned char hi = lo;
+            if (pos + 1 < s.size() && s[pos] == '-' && s[pos + 1] != ']') {
+                ++pos;
+                if (s[pos] == '\\') return false;
+                hi = static_cast<unsigned char>(s[pos++]);
+                if (hi < lo) return false;
+            }
+            for (unsigned b = lo; b <= hi; ++b) set.set(b);
+        }
+        if (atEnd()) return false;
+        ++pos; // ']'
+        if (negate) set.flip();
+        out = makeSet(set);
+        return true;
+    }
+
+    bool parseAtom(Ast& out) {
+        char c = s[pos++];
+        switch (c) {
+            case '(':
+                if (s.compare(pos, 2, "?:") == 0) pos += 2;
+                else if (!atEnd() && s[pos] == '?') return false; // lookarounds, named groups
+                if (!parseAlt(out)) return false;
+                if (atEnd() || s[pos] != ')') return false;
+                ++pos;
+                return true;
+            case '[':
+                return parseClass(out);
+            case '.': {
+                ByteSet set = allBytes();
+                set.reset('\n');
+                out = makeSet(set);
+                return true;
+            }
+            case '\\': {
+                ByteSet set;
+                if (!parseEscape(set)) return false;
+                out = makeSet(set);
+                return true;
+            }
+            case '^': case '$': case '*': case '+': case '?': case '{': case '}': case ']':
+                return false; // anchors in the middle, or a quantifier with nothing to repeat
+            default:
+                out = makeChar(static_cast<unsigned char>(c));
+                return true;
+        }
+    }
+};
+
+// Builds Thompson NFA fragments from syntax trees
+class NfaBuilder {
+public:
+    explicit NfaBuilder(std::vector<NfaState>& states) : st(states) {}
+
+    int add() {
+        st.push_back(NfaState());
+        return static_cast<int>(st.size() - 1);
+    }
+
+    // Returns the (start, end) states of a fragment accepting the language of a
+    std::pair<int, int> build(const Ast& a) {
+        switch (a.kind) {
+            case Ast::Set: {
+                int s = add();
+                int e = add();
+                st[s].hasSet = true;
+                st[s].set = a.set;
+                st[s].next = e;
+                return std::make_pair(s, e);
+            }
+            case Ast::Concat: {
+                int s = add();
+                int cur = s;
+                for (size_t i = 0; i < a.children.size(); ++i) {
+                    std::pair<int, int> f = build(a.children[i]);
+                    st[cur].eps.push_back(f.first);
+                    cur = f.second;
+                }
+                return std::make_pair(s, cur);
+            }
+            case Ast::Alt: {
+                int s = add();
+                int e = add();
+                for (size_t i = 0; i < a.children.size(); ++i) {
+                    std::pair<int, int> f = build(a.children[i]);
+                    st[s].eps.push_back(f.first);
+                    st[f.second].eps.push_back(e);
+                }
+                return std::make_pair(s, e);
+            }
+            case Ast::Repeat: {
+                const Ast& child = a.children[0];
+                int s = add();
+                int cur = s;
+                for (int i = 0; i < a.min; ++i) {
+                    std::pair<int, int> f = build(child);
+                    st[cur].eps.push_back(f.first);
+                    cur = f.second;
+                }
+                int e = add();
+                if (a.max < 0) {
+                    std::pair<int, int> f = build(child);
+                    st[cur].eps.push_back(f.first);
+                    st[f.second].eps.push_back(f.first);
+                    st[f.second].eps.push_back(e);
+                } else {
+                    for (int i = a.min; i < a.max; ++i) {
+                        std::pair<int, int> f = build(child);
+                        st[cur].eps.push_back(f.first);
+                        st[cur].eps.push_back(e);
+                        cur = f.second;
+                    }
+                }
+                st[cur].eps.push_back(e);
+                return std::make_pair(s, e);
+            }
+        }
+        return std::make_pair(add(), add());
+    }
+private:
+    std::vector<NfaState>& st;
+};
+
+} // namespace
+
+ProcessMatcher::ProcessMatcher(const std::vector<ProcessInfo>& rules) {
+    NfaBuilder builder(nfa);
+    nfaStart = builder.add();
+    bool anyPattern = false;
+
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const std::string name = rules[i].getName();
+        ruleNames.push_back(name);
+        ruleIndex[name] = i;
+
+        Ast ast;
+        switch (rules[i].getMatchKind()) {
+            case MatchKind::Exact:
+                exact[name].push_back(i);
+                continue;
+            case MatchKind::Glob:
+                ast = parseGlob(name);
+                break;
+            case MatchKind::Regex: {
+                RegexParser parser(name);
+                if (!parser.parse(ast)) {
+                    try {
+                        fallbackRegexes.push_back(std::make_pair(i, std::regex(name, std::regex::ECMAScript | std::regex::optimize)));
+                    } catch (const std::regex_error&) {
+                        logToWindowsEventLog("Invalid regex in config, entry ignored: " + name, WDOG_LOG_WARNING);
+                    }
+                    continue;
+                }
+                break;
+            }
+        }
+        std::pair<int, int> f = builder.build(ast);
+        int accept = builder.add();
+        nfa[accept].rule = static_cast<int>(i);
+        nfa[f.second].eps.push_back(accept);
+        nfa[nfaStart].eps.push_back(f.first);
+        anyPattern = true;
+    }
+    for (std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = exact.begin(); it != exact.end(); ++it) {
+        sortedExact.push_back(it->first);
+    }
+    std::sort(sortedExact.begin(), sortedExact.end());
+
+    if (anyPattern) {
+        compilePatterns();
+    } else {
+        nfa.clear();
+        nfaStart = -1;
+    }
+}
+
+// Epsilon closure of a set of NFA states, keeping only the states that matter for matching
+// (those with a byte transition or an accepting rule), sorted so equal sets compare equal
+std::vector<int> ProcessMatcher::closure(const std::vector<int>& seeds) const {
+    std::vector<char> seen(nfa.size(), 0);
+    std::vector<int> stack(seeds);
+    std::vector<int> out;
+    while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        if (seen[s]) continue;
+        seen[s] = 1;
+        if (nfa[s].hasSet || nfa[s].rule >= 0) out.push_back(s);
+        for (size_t i = 0; i < nfa[s].eps.size(); ++i) stack.push_back(nfa[s].eps[i]);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Groups bytes into classes and determinises the pattern NFA
+void ProcessMatcher::compilePatterns() {
+    // Byte classes: two bytes share a class if every transition set contains both or neither
+    classCount = 1;
+    for (size_t s = 0; s < nfa.size(); ++s) {
+        if (!nfa[s].hasSet) continue;
+        std::map<std::pair<int, bool>, int> remap;
+        unsigned char refined[256];
+        for (unsigned b = 0; b < 256; ++b) {
+            std::pair<int, bool> key(byteClass[b], nfa[s].set.test(b));
+            std::map<std::pair<int, bool>, int>::iterator it = remap.find(key);
+            if (it == remap.end()) it = remap.insert(std::make_pair(key, static_cast<int>(remap.size()))).first;
+            refined[b] = static_cast<unsigned char>(it->second);
+        }
+        std::copy(refined, refined + 256, byteClass);
+        classCount = remap.size();
+    }
+    std::vector<unsigned char> representative(classCount);
+    for (int b = 255; b >= 0; --b) representative[byteClass[b]] = static_cast<unsigned char>(b);
+
+    // Subset construction
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int> > sets;
+    sets.push_back(closure(std::vector<int>(1, nfaStart)));
+    ids[sets[0]] = 0;
+    transitions.clear();
+    accepts.clear();
+    for (size_t d = 0; d < sets.size(); ++d) {
+        if (sets.size() > kMaxDfaStates) {
+            logToWindowsEventLog("Process name patterns too complex for a DFA, using NFA matching", WDOG_LOG_WARNING);
+            transitions.clear();
+            accepts.clear();
+            dfaBuilt = false;
+            return;
+        }
+        std::vector<size_t> rules;
+        for (size_t i = 0; i < sets[d].size(); ++i) {
+            if (nfa[sets[d][i]].rule >= 0) rules.push_back(static_cast<size_t>(nfa[sets[d][i]].rule));
+        }
+        accepts.push_back(rules);
+
+        for (size_t c = 0; c < classCount; ++c) {
+            std::vector<int> moved;
+            for (size_t i = 0; i < sets[d].size(); ++i) {
+                const NfaState& st = nfa[sets[d][i]];
+                if (st.hasSet && st.set.test(representative[c])) moved.push_back(st.next);
+            }
+            int target = -1;
+            if (!moved.empty()) {
+                std::vector<int> next = closure(moved);
+                std::map<std::vector<int>, int>::iterator it = ids.find(next);
+                if (it == ids.end()) {
+                    it = ids.insert(std::make_pair(next, static_cast<int>(sets.size()))).first;
+                    sets.push_back(next);
+                }
+                target = it->second;
+            }
+            transitions.push_back(target);
+        }
+    }
+    dfaBuilt = true;
+}
+
+int ProcessMatcher::findRule(const std::string& name) const {
+    std::unordered_map<std::string, size_t>::const_iterator it = ruleIndex.find(name);
+    return it == ruleIndex.end() ? -1 : static_cast<int>(it->second);
+}
+
+void ProcessMatcher::match(const std::string& name, std::vector<size_t>& hits) const {
+    std::unordered_map<std::string, std::vector<size_t> >::const_iterator it = exact.find(name);
+    if (it != exact.end()) hits.insert(hits.end(), it->second.begin(), it->second.end());
+
+    if (dfaBuilt) {
+        int state = 0;
+        for (size_t i = 0; i < name.size() && state >= 0; ++i) {
+            state = transitions[state * classCount + byteClass[static_cast<unsigned char>(name[i])]];
+        }
+        if (state >= 0) hits.insert(hits.end(), accepts[state].begin(), accepts[state].end());
+    } else if (nfaStart >= 0) {
+        // DFA too large: simulate the NFA on the fly
+        std::vector<int> current = closure(std::vector<int>(1, nfaStart));
+        for (size_t i = 0; i < name.size() && !current.empty(); ++i) {
+            std::vector<int> moved;
+            for (size_t j = 0; j < current.size(); ++j) {
+                const NfaState& st = nfa[current[j]];
+                if (st.hasSet && st.set.test(static_cast<unsigned char>(name[i]))) moved.push_back(st.next);
+            }
+            current = closure(moved);
+        }
+        for (size_t j = 0; j < current.size(); ++j) {
+            if (nfa[current[j]].rule >= 0) hits.push_back(static_cast<size_t>(nfa[current[j]].rule));
+        }
+    }
+
+    for (size_t i = 0; i < fallbackRegexes.size(); ++i) {
+        if (std::regex_match(name, fallbackRegexes[i].second)) hits.push_back(fallbackRegexes[i].first);
+    }
+}
+
+bool ProcessMatcher::mayMatchLonger(const std::string& prefix) const {
+    // Exact names: the first name not sorting before prefix is the only candidate that can extend it
+    std::vector<std::string>::const_iterator it = std::lower_bound(sortedExact.begin(), sortedExact.end(), prefix);
+    if (it != sortedExact.end() && it->size() > prefix.size() && it->compare(0, prefix.size(), prefix) == 0) {
+        return true;
+    }
+    if (!fallbackRegexes.empty()) return true; // cannot be answered for std::regex, so assume yes
+
+    if (dfaBuilt) {
+        int state = 0;
+        for (size_t i = 0; i < prefix.size() && state >= 0; ++i) {
+            state = transitions[state * classCount + byteClass[static_cast<unsigned char>(prefix[i])]];
+        }
+        if (state < 0) return false;
+        for (size_t c = 0; c < classCount; ++c) {
+            if (transitions[state * classCount + c] >= 0) return true;
+        }
+    } else if (nfaStart >= 0) {
+        std::vector<int> current = closure(std::vector<int>(1, nfaStart));
+        for (size_t i = 0; i < prefix.size() && !current.empty(); ++i) {
+            std::vector<int> moved;
+            for (size_t j = 0; j < current.size(); ++j) {
+                const NfaState& st = nfa[current[j]];
+                if (st.hasSet && st.set.test(static_cast<unsigned char>(prefix[i]))) moved.push_back(st.next);
+            }
+            current = closure(moved);
+        }
+        for (size_t j = 0; j < current.size(); ++j) {
+            if (nfa[current[j]].hasSet) return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "ProcessInfo.h"
+#include <bitset>
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Classifies a process name against every configured process entry in a single pass.
+// It is compiled once per config load from the "processes" list:
+// - exact names go into a hash map
+// - globs and regexes are compiled together into one DFA, so matching a name costs one table
+//   lookup per character no matter how many patterns there are
+// - regexes using features the DFA compiler does not support (back-references, lookarounds, ...)
+//   are kept as std::regex and checked one by one
+class ProcessMatcher {
+public:
+    ProcessMatcher() {}
+    explicit ProcessMatcher(const std::vector<ProcessInfo>& rules);
+
+    bool empty() const { return ruleNames.empty(); }
+    size_t ruleCount() const { return ruleNames.size(); }
+    const std::string& ruleName(size_t rule) const { return ruleNames[rule]; }
+
+    // Index of the entry with the given configured name, or -1 if there is none
+    int findRule(const std::string& name) const;
+
+    // Appends the index of every entry that matches the process name to hits
+    void match(const std::string& name, std::vector<size_t>& hits) const;
+
+    // Whether some entry could match a name that starts with prefix and is longer than it.
+    // Used to decide whether a possibly truncated process name is worth resolving in full.
+    bool mayMatchLonger(const std::string& prefix) const;
+
+    // One state of the pattern NFA; public only so the compiler in ProcessMatcher.cpp can build it
+    struct NfaState {
+        std::bitset<256> set; // bytes accepted by the transition to next (if hasSet)
+        bool hasSet = false;
+        int next = -1;
+        std::vector<int> eps; // epsilon transitions
+        int rule = -1;        // accepting state for this rule
+    };
+private:
+    void compilePatterns();
+    std::vector<int> closure(const std::vector<int>& seeds) const;
+
+    std::vector<std::string> ruleNames;
+    std::unordered_map<std::string, size_t> ruleIndex;
+    std::unordered_map<std::string, std::vector<size_t> > exact;
+    std::vector<std::string> sortedExact; // exact names in order, for prefix lookups
+    std::vector<std::pair<size_t, std::regex> > fallbackRegexes;
+
+    // Pattern automaton: the NFA is always kept; the DFA is used unless it grew too large
+    std::vector<NfaState> nfa;
+    int nfaStart = -1;
+    bool dfaBuilt = false;
+    unsigned char byteClass[256] = {};
+    size_t classCount = 0;
+    std::vector<int> transitions;             // state * classCount + class -> state, -1 = no match possible
+    std::vector<std::vector<size_t> > accepts; // rules accepted in each DFA state
+};
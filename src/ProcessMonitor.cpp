@@ -1,5 +1,7 @@
 #include "ProcessMonitor.h"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <thread>
 #include "Logger.h" 
@@ -7,22 +9,54 @@
 ProcessMonitor::ProcessMonitor(ConfigManager& cfg, OSApiWrapper& api)
     : cfg(cfg), api(api) {}
 
+// Launches the executable of a monitored entry. Pattern entries without "exe" are only watched.
+LaunchResult ProcessMonitor::startMonitored(const ProcessInfo& info) {
+    const std::string exe = info.getExe();
+    if (exe.empty()) {
+        logToWindowsEventLog("No running process matches: " + info.getName(), WDOG_LOG_WARNING);
+        return LaunchResult::Unlaunchable;
+    }
+    return api.startService(info);
+}
+
+// Logs how a started process ended, with its last output if it failed and its output is captured.
+// Its snapshot entry is already gone, so the checks of this tick restart it as soon as its restart
+// delay allows
+void ProcessMonitor::logExit(const ProcessExit& exit) {
+    std::string how = exit.signal != 0 ? "killed by signal " + std::to_string(exit.signal)
+                                       : "exit code " + std::to_string(exit.exitCode);
+    char usage[96];
+    std::snprintf(usage, sizeof(usage), "user %.2fs, sys %.2fs, max rss %ld KB",
+                  exit.userCpuSeconds, exit.systemCpuSeconds, exit.maxRssKb);
+    std::string message = "Process exited: " + exit.name + " (pid " + std::to_string(exit.pid) + ", " + how +
+                          ", " + usage + ")";
+    if (!exit.output.empty()) message += ", last output:\n" + exit.output;
+    logToWindowsEventLog(message, WDOG_LOG_WARNING);
+}
+
 void ProcessMonitor::run(std::function<bool()> keepRunning) {
     std::unordered_map<std::string, ProcessInfo> monitored;
     for (const auto& p : cfg.getProcesses()) {
         monitored[p.getName()] = p;
     }
+    api.configure(cfg);
+    scheduler.configure(cfg.getProcesses(), cfg.getSettings());
 
     while (keepRunning()) {
+        // Let the OS layer take its process-table snapshot for this tick
+        api.beginTick();
+        for (const auto& exit : api.takeExitedProcesses()) {
+            logExit(exit);
+            if (!exit.service.empty()) scheduler.noteExit(exit.service, exit.signal == 0 && exit.exitCode == 0);
+        }
+
         // Reload config if changed
         if (cfg.reloadIfChanged()) {
+            api.configure(cfg);
+            scheduler.configure(cfg.getProcesses(), cfg.getSettings());
             std::unordered_map<std::string, ProcessInfo> newMonitored;
             for (const auto& p : cfg.getProcesses()) {
                 newMonitored[p.getName()] = p;
-                if (monitored.find(p.getName()) == monitored.end()) {
-                    if (!api.isProcessRunning(p.getName()))
-                        api.startProcess(p.getName(), p.getArgs());
-                }
             }
             for (auto it = monitored.begin(); it != monitored.end(); ++it) {
                 const std::string& name = it->first;
@@ -35,21 +69,30 @@ void ProcessMonitor::run(std::function<bool()> keepRunning) {
             api.bringToForeground(cfg.getForegroundApp());
         }
 
-        // Ensure all monitored processes are running
-        for (auto it = monitored.begin(); it != monitored.end(); ++it) {
-            const std::string& name = it->first;
-            const ProcessInfo& info = it->second;
-            if (!api.isProcessRunning(name)) {
-                logToWindowsEventLog("Process stopped, restarting: " + name, WDOG_LOG_WARNING);
-                api.startProcess(name, info.getArgs());
-            }
-        }
+        // Ensure all monitored processes are running; new entries are started here too, in dependency order
+        scheduler.run(
+            [this](const std::string& name) { return api.isProcessRunning(name); },
+            [this](const ProcessInfo& info) {
+                logToWindowsEventLog("Process stopped, restarting: " + info.getName(), WDOG_LOG_WARNING);
+                return startMonitored(info);
+            },
+            StartupScheduler::Clock::now());
          // Always enforce the configured foreground app is in the foreground
         const std::string& fgApp = cfg.getForegroundApp();
         if (!fgApp.empty() && !api.isProcessInForeground(fgApp)) {
             api.bringToForeground(fgApp);
         }   
+        api.endTick();
 
-        std::this_thread::sleep_for(std::chrono::seconds(2));
+        // Sleep until the next tick, or less if the OS layer reports a process exit or a restart delay ends
+        const auto now = StartupScheduler::Clock::now();
+        const auto retryAt = scheduler.nextRetryAt(now);
+        long long waitMs = 2000;
+        if (retryAt < now + std::chrono::milliseconds(waitMs)) {
+            // Rounded up, so the delay has passed when the tick runs
+            waitMs = std::max<long long>(0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                retryAt - now + std::chrono::microseconds(999)).count());
+        }
+        api.waitForEvents(static_cast<int>(waitMs));
     }
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include "ConfigManager.h"
 #include "OSApiWrapper.h"
+#include "StartupScheduler.h"
 #include <unordered_map>
 #include <atomic>
 #include <functional>
@@ -12,8 +13,12 @@ public:
     void run(std::function<bool()> keepRunning);
     void stop();        
 private:
+    LaunchResult startMonitored(const ProcessInfo& info);
+    void logExit(const ProcessExit& exit);
+
     ConfigManager& cfg;
     OSApiWrapper& api;
     std::unordered_map<std::string, ProcessInfo> monitored; // name -> info
+    StartupScheduler scheduler; // start order and concurrency of the monitored entries
     std::atomic<bool> running{true};
 };
\ No newline at end of file
@@ -0,0 +1,283 @@
+/*
+    StartupScheduler.cpp - Dependency-ordered, bounded-parallel startup of monitored processes
+
+    Without it the monitor started missing entries one by one in hash-map order, so a service could be
+    launched before the database it needs, and a host with hundreds of entries came up in whatever order
+    the map happened to have. The scheduler:
+
+    - sorts the entries topologically by "depends_on" (Kahn's algorithm, ties kept in config order)
+    - starts, in waves, every entry whose prerequisites are running; all entries of a wave are launched
+      back to back instead of one per tick
+    - keeps at most maxStarting entries "starting" (launched but not yet seen running), so a cold boot
+      does not fork hundreds of processes into a host that is still busy with the first ones
+    - re-checks the entries it just started only when something is waiting for them, so a chain of
+      dependencies comes up within one monitor tick, while a tick with nothing to wait for still costs
+      exactly one isProcessRunning call per entry
+    - restarts an entry that stopped once right away, and after that only after a delay that doubles with
+      every further stop (up to a cap) and is jittered, so a service that dies instantly is no longer
+      relaunched every tick, and services that died together do not all come back in the same instant; an
+      entry started more than "restart_burst" times within "restart_burst_window" seconds is marked failed
+      and left alone until the config is reloaded
+    - uses the outcome of each launch: a launch that failed counts as a stop right away instead of holding
+      a slot until the start timeout, and an entry whose executable cannot be run is marked failed at once
+    - honours "restart": "on-failure" entries that exit with status 0 are not started again
+*/
+
+#include "StartupScheduler.h"
+#include "Logger.h"
+#include <algorithm>
+#include <set>
+
+StartupScheduler::StartupScheduler() : rng(std::random_device()()) {}
+
+void StartupScheduler::configure(const std::vector<ProcessInfo>& procs, const WatchdogSettings& settings) {
+    maxStarting = settings.startConcurrency;
+    delayMs = settings.restartDelayMs;
+    delayMaxMs = std::max(settings.restartDelayMaxMs, settings.restartDelayMs);
+    burst = settings.restartBurst;
+    burstWindowSeconds = settings.restartBurstWindow;
+
+    // Keep the starting state of entries that survive a reload
+    std::unordered_map<std::string, Node> previous;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        previous[nodes[i].info.getName()] = nodes[i];
+    }
+
+    std::unordered_map<std::string, size_t> configIndex;
+    for (size_t i = 0; i < procs.size(); ++i) {
+        configIndex[procs[i].getName()] = i;
+    }
+
+    // Dependency graph in config order
+    std::vector<std::vector<size_t> > deps(procs.size());
+    std::vector<std::vector<size_t> > dependents(procs.size());
+    std::vector<size_t> pending(procs.size(), 0);
+    for (size_t i = 0; i < procs.size(); ++i) {
+        const std::vector<std::string>& names = procs[i].getDependsOn();
+        for (size_t j = 0; j < names.size(); ++j) {
+            std::unordered_map<std::string, size_t>::const_iterator it = configIndex.find(names[j]);
+            if (it == configIndex.end() || it->second == i) {
+                logToWindowsEventLog("Ignoring unknown dependency '" + names[j] + "' of " + procs[i].getName(),
+                                     WDOG_LOG_WARNING);
+                continue;
+            }
+            deps[i].push_back(it->second);
+            dependents[it->second].push_back(i);
+            ++pending[i];
+        }
+    }
+
+    // Kahn's algorithm; the ready set is ordered by config position, so independent entries keep their order.
+    // When only entries of a cycle are left, the first of them in config order drops its dependencies on the
+    // entries not yet placed; everything else keeps waiting for its prerequisites.
+    std::vector<size_t> order;
+    std::vector<char> placed(procs.size(), 0);
+    std::set<size_t> ready;
+    for (size_t i = 0; i < procs.size(); ++i) {
+        if (pending[i] == 0) ready.insert(i);
+    }
+    while (order.size() < procs.size()) {
+        if (ready.empty()) {
+            size_t i = 0;
+            while (placed[i] || pending[i] == 0) ++i;
+            std::string dropped;
+            std::vector<size_t> kept;
+            for (size_t j = 0; j < deps[i].size(); ++j) {
+                if (placed[deps[i][j]]) {
+                    kept.push_back(deps[i][j]);
+                } else {
+                    dropped += (dropped.empty() ? "" : ", ") + procs[deps[i][j]].getName();
+                }
+            }
+            deps[i] = kept;
+            pending[i] = 0;
+            ready.insert(i);
+            logToWindowsEventLog("Dependency cycle, ignoring the dependencies of " + procs[i].getName() + " on: " +
+                                 dropped, WDOG_LOG_WARNING);
+        }
+        size_t i = *ready.begin();
+        ready.erase(ready.begin());
+        placed[i] = 1;
+        order.push_back(i);
+        for (size_t j = 0; j < dependents[i].size(); ++j) {
+            size_t d = dependents[i][j];
+            if (pending[d] > 0 && --pending[d] == 0) ready.insert(d);
+        }
+    }
+
+    std::vector<size_t> position(procs.size());
+    for (size_t k = 0; k < order.size(); ++k) position[order[k]] = k;
+    nodes.clear();
+    nodes.resize(order.size());
+    index.clear();
+    for (size_t k = 0; k < order.size(); ++k) {
+        Node& node = nodes[k];
+        std::unordered_map<std::string, Node>::const_iterator old = previous.find(procs[order[k]].getName());
+        if (old != previous.end()) {
+            node = old->second;
+            node.deps.clear();
+            node.finished = false;
+            if (node.failed) {
+                node.failed = false;
+                node.failures = 0;
+                node.starts.clear();
+            }
+        }
+        node.info = procs[order[k]];
+        for (size_t j = 0; j < deps[order[k]].size(); ++j) {
+            node.deps.push_back(position[deps[order[k]][j]]);
+        }
+        index[node.info.getName()] = k;
+    }
+}
+
+void StartupScheduler::noteExit(const std::string& name, bool clean) {
+    std::unordered_map<std::string, size_t>::const_iterator it = index.find(name);
+    if (it == index.end()) return;
+    Node& n = nodes[it->second];
+    if (n.exit != FailedExit) n.exit = clean ? CleanExit : FailedExit; // a failure wins over a clean exit
+}
+
+bool StartupScheduler::hasFailed(const std::string& name) const {
+    std::unordered_map<std::string, size_t>::const_iterator it = index.find(name);
+    return it != index.end() && nodes[it->second].failed;
+}
+
+// Helper: Book a stop of a launchable entry and work out when it may be started again
+void StartupScheduler::stopped(Node& n, bool clean, Clock::time_point now) {
+    n.starting = false;
+    if (clean && n.info.getRestartPolicy() == RestartPolicy::OnFailure) {
+        n.finished = true;
+        logToWindowsEventLog("Process exited cleanly, not restarting: " + n.info.getName());
+        return;
+    }
+    ++n.failures;
+    // The first stop after a stable run is restarted right away (the exit is usually reported in the same
+    // tick); from the second one on, exponential backoff with "equal jitter": half of the delay is fixed,
+    // the other half random
+    if (n.failures == 1) {
+        n.retryAt = now;
+        return;
+    }
+    unsigned long long delay = delayMs;
+    for (unsigned i = 2; i < n.failures && delay < delayMaxMs; ++i) delay *= 2;
+    delay = std::min<unsigned long long>(delay, delayMaxMs);
+    unsigned long long half = delay / 2;
+    delay = delay - half + (half > 0 ? rng() % (half + 1) : 0);
+    n.retryAt = now + std::chrono::milliseconds(delay);
+    logToWindowsEventLog(n.info.getName() + " stopped " + std::to_string(n.failures) +
+                         " times in a row, restarting in " + std::to_string(delay) + " ms", WDOG_LOG_WARNING);
+}
+
+// Helper: Whether the restart policy lets the entry start now; records the start if so
+bool StartupScheduler::admitStart(Node& n, Clock::time_point now) {
+    if (n.failed || n.finished || now < n.retryAt) return false;
+    if (burst > 0) {
+        const Clock::time_point windowStart = now - std::chrono::seconds(burstWindowSeconds);
+        while (!n.starts.empty() && n.starts.front() <= windowStart) n.starts.pop_front();
+        if (n.starts.size() >= burst) {
+            n.failed = true;
+            logToWindowsEventLog("Process failed: " + n.info.getName() + " was started " + std::to_string(burst) +
+                                 " times within " + std::to_string(burstWindowSeconds) +
+                                 " s, not restarting it until the config is reloaded", WDOG_LOG_WARNING);
+            return false;
+        }
+        n.starts.push_back(now);
+    }
+    return true;
+}
+
+void StartupScheduler::run(const std::function<bool(const std::string&)>& isUp,
+                           const std::function<LaunchResult(const ProcessInfo&)>& start, Clock::time_point now) {
+    const Clock::duration timeout = std::chrono::seconds(kStartTimeoutSeconds);
+    const Clock::duration stable = std::chrono::seconds(burstWindowSeconds);
+    unsigned starting = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        Node& n = nodes[i];
+        n.up = isUp(n.info.getName());
+        if (n.up) {
+            // Running again, whoever started it: a failed or finished entry is supervised again
+            if (n.wasUp && now - n.upSince >= stable) n.failures = 0;
+            n.starting = false;
+            n.failed = false;
+            n.finished = false;
+        } else if (!n.info.getExe().empty() &&
+                   (n.exit != NoExit || n.wasUp || (n.starting && now - n.startedAt >= timeout))) {
+            // It ended (reported exit, was running last round, or a start that never came up)
+            stopped(n, n.exit == CleanExit, now);
+        }
+        n.exit = NoExit;
+        if (n.starting) ++starting;
+    }
+
+    std::vector<char> tried(nodes.size(), 0); // start() is called at most once per entry and round
+    while (true) {
+        bool waiting = false; // an entry waits for a starting prerequisite or for a free slot
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Node& n = nodes[i];
+            if (n.up || n.starting || tried[i]) continue;
+            bool ready = true;
+            for (size_t j = 0; j < n.deps.size(); ++j) {
+                const Node& dep = nodes[n.deps[j]];
+                if (dep.up) continue;
+                ready = false;
+                if (dep.starting) waiting = true;
+            }
+            if (!ready) continue;
+            bool launchable = !n.info.getExe().empty();
+            if (launchable && maxStarting > 0 && starting >= maxStarting) {
+                waiting = true;
+                continue;
+            }
+            if (launchable && !admitStart(n, now)) continue;
+            tried[i] = 1;
+            LaunchResult result = start(n.info);
+            if (!launchable) continue;
+            if (result == LaunchResult::Started) {
+                n.starting = true;
+                n.startedAt = now;
+                ++starting;
+            } else if (result == LaunchResult::Unlaunchable) {
+                n.failed = true;
+                logToWindowsEventLog("Process failed: " + n.info.getName() +
+                                     " cannot be launched, not restarting it until the config is reloaded",
+                                     WDOG_LOG_WARNING);
+            } else {
+                stopped(n, false, now);
+            }
+        }
+        if (!waiting) break;
+
+        // Something waits on the entries still starting: see whether they are up by now
+        bool progress = false;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            Node& n = nodes[i];
+            if (!n.starting || !isUp(n.info.getName())) continue;
+            n.starting = false;
+            n.up = true;
+            --starting;
+            progress = true;
+        }
+        if (!progress) break;
+    }
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        if (nodes[i].up && !nodes[i].wasUp) nodes[i].upSince = now;
+        nodes[i].wasUp = nodes[i].up;
+    }
+}
+
+StartupScheduler::Clock::time_point StartupScheduler::nextRetryAt(Clock::time_point now) const {
+    Clock::time_point next = Clock::time_point::max();
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const Node& n = nodes[i];
+        if (n.up || n.starting || n.failed || n.finished || n.retryAt <= now) continue;
+        next = std::min(next, n.retryAt);
+    }
+    return next;
+}
+
+std::vector<std::string> StartupScheduler::order() const {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < nodes.size(); ++i) names.push_back(nodes[i].info.getName());
+    return names;
+}
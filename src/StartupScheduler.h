@@ -0,0 +1,90 @@
+#pragma once
+#include "ConfigManager.h"
+#include "OSApiWrapper.h"
+#include "ProcessInfo.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Decides which config entries to start, and when, so that an entry only starts once everything it
+// depends on ("depends_on") is running, and no more than a fixed number of entries are starting at once.
+// Entries are kept in dependency (topological) order; independent entries start together in one wave.
+// It also applies the restart policy: an entry that stops is restarted at once, but one that keeps dying
+// is restarted after an exponentially growing, jittered delay, and is marked failed once it was started
+// too often within a window.
+class StartupScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // Entries that were started but are still not seen running after this long no longer hold a slot
+    static const int kStartTimeoutSeconds = 30;
+
+    StartupScheduler();
+
+    // Sorts the entries by their dependencies. Unknown prerequisites are ignored, and a cycle is broken
+    // at its first entry in config order (both are logged). Takes the start concurrency and the restart
+    // limits from settings. Entries that keep their name keep their starting and backoff state; entries
+    // marked failed get another chance.
+    void configure(const std::vector<ProcessInfo>& procs, const WatchdogSettings& settings);
+
+    // Reports that a process started for the entry has ended; clean means it exited with status 0.
+    // The next run() treats the entry as stopped (if nothing else keeps it running) without waiting
+    // for the start timeout, and an "on-failure" entry that ended cleanly is not started again.
+    void noteExit(const std::string& name, bool clean);
+
+    // One round of starts, made once per monitor tick: asks isUp() about every entry once, then calls
+    // start() for every entry that is down and whose prerequisites are all up, while fewer than
+    // maxStarting launched entries are still not up. Entries waiting out their restart delay, failed
+    // entries and finished "on-failure" entries are skipped. Entries that cannot be launched (no executable)
+    // are passed to start() as well but never hold a slot. A launch that failed counts as a stop; one
+    // that can never succeed (e.g. missing executable) marks the entry failed right away. When dependents
+    // or entries waiting for a slot remain, the entries just started are asked again, so a whole chain
+    // can come up in one round.
+    void run(const std::function<bool(const std::string&)>& isUp,
+             const std::function<LaunchResult(const ProcessInfo&)>& start, Clock::time_point now);
+
+    // When the first restart delay still running after now ends, or Clock::time_point::max() if no entry
+    // waits for one; the monitor sleeps no longer than that
+    Clock::time_point nextRetryAt(Clock::time_point now) const;
+
+    // Entry names in the order they are considered (prerequisites first)
+    std::vector<std::string> order() const;
+
+    // Whether the entry was started too often within the burst window, or cannot be launched at all,
+    // and is no longer restarted
+    bool hasFailed(const std::string& name) const;
+private:
+    enum ExitSeen { NoExit, CleanExit, FailedExit };
+
+    struct Node {
+        ProcessInfo info;
+        std::vector<size_t> deps;  // indices of prerequisites
+        bool starting = false;     // launched, not yet seen up
+        Clock::time_point startedAt;
+        bool up = false;           // as of the current round
+        bool wasUp = false;        // as of the previous round
+        Clock::time_point upSince;
+        ExitSeen exit = NoExit;    // reported by noteExit since the previous round
+        unsigned failures = 0;     // stops since the entry last ran for a whole burst window
+        Clock::time_point retryAt; // not started again before this
+        std::deque<Clock::time_point> starts; // start times within the burst window
+        bool failed = false;       // burst limit hit or unlaunchable
+        bool finished = false;     // "on-failure" entry that exited cleanly
+    };
+
+    void stopped(Node& n, bool clean, Clock::time_point now);
+    bool admitStart(Node& n, Clock::time_point now);
+
+    std::vector<Node> nodes; // topological order
+    std::unordered_map<std::string, size_t> index; // name -> position in nodes
+    unsigned maxStarting = 0;
+    unsigned delayMs = 0;
+    unsigned delayMaxMs = 0;
+    unsigned burst = 0;
+    unsigned burstWindowSeconds = 0;
+    std::minstd_rand rng;
+};
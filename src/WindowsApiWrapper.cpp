@@ -71,7 +71,9 @@
 #include "OSApiWrapper.h"
 #include <Windows.h>
 #include <TlHelp32.h>
+#include <algorithm>
 #include <iostream>
+#include "ConfigManager.h"
 #include "Logger.h"
 
 // Converts a wide string (WCHAR*) to a UTF-8 std::string
@@ -100,7 +102,27 @@ static bool iequals(const std::string& a, const std::string& b) {
         );
 }
 
-// Checks if a process with the given name is running
+void WindowsApiWrapper::configure(const ConfigManager& cfg) {
+    matcher = cfg.getMatcher();
+    patternRules.clear();
+    for (const auto& p : cfg.getProcesses()) {
+        if (p.getMatchKind() == MatchKind::Exact) continue;
+        int rule = matcher.findRule(p.getName());
+        if (rule >= 0) patternRules[p.getName()] = static_cast<size_t>(rule);
+    }
+}
+
+// Helper: Whether name is a glob or regex entry that matches the executable name (case-sensitive, as
+// Windows reports it, e.g. "worker-1.exe"). Exact entries are compared by the callers themselves
+bool WindowsApiWrapper::matchesPattern(const std::string& name, const std::string& exeFile) {
+    auto it = patternRules.find(name);
+    if (it == patternRules.end()) return false;
+    matchHits.clear();
+    matcher.match(exeFile, matchHits);
+    return std::find(matchHits.begin(), matchHits.end(), it->second) != matchHits.end();
+}
+
+// Checks if a process with the given name (or matching the given glob/regex entry) is running
 bool WindowsApiWrapper::isProcessRunning(const std::string& name) {
     logToWindowsEventLog("Checking if process is running: " + name);
     // Take a snapshot of all processes in the system
@@ -117,7 +139,8 @@ bool WindowsApiWrapper::isProcessRunning(const std::string& name) {
     if (Process32FirstW(hSnap, &pe)) {
         do {
             // Convert process name from WCHAR* to std::string and compare
-            if (iequals(name, ws2s(pe.szExeFile))) {
+            const std::string exeFile = ws2s(pe.szExeFile);
+            if (iequals(name, exeFile) || matchesPattern(name, exeFile)) {
                 found = true; // Found a matching process
                 break;
             }
@@ -132,7 +155,8 @@ bool WindowsApiWrapper::isProcessRunning(const std::string& name) {
     return found;
 }
 
-void WindowsApiWrapper::startProcess(const std::string& exe, const std::string& args) {
+// Helper: Start a process; returns 0 on success, otherwise the error of CreateProcessW (GetLastError)
+static DWORD launchProcess(const std::string& exe, const std::string& args) {
     // Convert the executable and arguments from UTF-8 std::string to wide string (std::wstring)
     std::wstring wexe(exe.begin(), exe.end());
     std::wstring wargs(args.begin(), args.end());
@@ -159,8 +183,31 @@ void WindowsApiWrapper::startProcess(const std::string& exe, const std::string&
         CloseHandle(pi.hProcess);
         CloseHandle(pi.hThread);
         logToWindowsEventLog("Started process: " + exe + " " + args, EVENTLOG_INFORMATION_TYPE);
-    } else {
-        logToWindowsEventLog("Failed to start process: " + exe + " " + args, EVENTLOG_ERROR_TYPE);
+        return 0;
+    }
+    DWORD error = GetLastError();
+    logToWindowsEventLog("Failed to start process: " + exe + " " + args + " (error " + std::to_string(error) + ")",
+                         EVENTLOG_ERROR_TYPE);
+    return error;
+}
+
+void WindowsApiWrapper::startProcess(const std::string& exe, const std::string& args) {
+    launchProcess(exe, args);
+}
+
+// Starts a config entry. CreateProcessW fails synchronously, so a missing or invalid executable is
+// reported as Unlaunchable and the entry is not retried every tick
+LaunchResult WindowsApiWrapper::startService(const ProcessInfo& info) {
+    switch (launchProcess(info.getExe(), info.getArgs())) {
+        case 0:
+            return LaunchResult::Started;
+        case ERROR_FILE_NOT_FOUND:
+        case ERROR_PATH_NOT_FOUND:
+        case ERROR_BAD_EXE_FORMAT:
+        case ERROR_ACCESS_DENIED:
+            return LaunchResult::Unlaunchable;
+        default:
+            return LaunchResult::Failed;
     }
 }
 
@@ -179,7 +226,8 @@ void WindowsApiWrapper::killProcess(const std::string& name) {
     if (Process32FirstW(hSnap, &pe)) {
         do {
             // Compare process name (converted from WCHAR* to std::string)
-            if (name == ws2s(pe.szExeFile)) {
+            const std::string exeFile = ws2s(pe.szExeFile);
+            if (name == exeFile || matchesPattern(name, exeFile)) {
                 // Open the process with permission to terminate
                 HANDLE hProc = OpenProcess(PROCESS_TERMINATE, FALSE, pe.th32ProcessID);
                 if (hProc) {
@@ -226,7 +274,8 @@ void WindowsApiWrapper::bringToForeground(const std::string& name) {
     if (Process32FirstW(hSnap, &pe)) {
         do {
             // Convert process name from WCHAR* to std::string and compare
-            if (name == ws2s(pe.szExeFile)) {
+            const std::string exeFile = ws2s(pe.szExeFile);
+            if (name == exeFile || matchesPattern(name, exeFile)) {
                 pid = pe.th32ProcessID; // Store the process ID
                 break;
             }
@@ -277,7 +326,8 @@ bool WindowsApiWrapper::isProcessInForeground(const std::string& name) {
         do {
             if (pe.th32ProcessID == foregroundPid) {
                 // Compare the process name (case-insensitive)
-                if (iequals(name, ws2s(pe.szExeFile))) {
+                const std::string exeFile = ws2s(pe.szExeFile);
+                if (iequals(name, exeFile) || matchesPattern(name, exeFile)) {
                     isForeground = true;
                 }
                 break;
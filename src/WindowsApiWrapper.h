@@ -1,5 +1,9 @@
 #pragma once
 #include "OSApiWrapper.h"
+#include "ProcessMatcher.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 // Concrete implementation of OSApiWrapper for Windows
 class WindowsApiWrapper : public OSApiWrapper {
@@ -9,7 +13,17 @@ public:
 
     bool isProcessRunning(const std::string& name) override;
     void startProcess(const std::string& exe, const std::string& args) override;
+    LaunchResult startService(const ProcessInfo& info) override;
     void killProcess(const std::string& name) override;
     void bringToForeground(const std::string& name) override;
     bool isProcessInForeground(const std::string& name) override;
+
+    // Takes the matcher compiled at config load, so glob and regex entries match running executables
+    void configure(const ConfigManager& cfg) override;
+private:
+    bool matchesPattern(const std::string& name, const std::string& exeFile);
+
+    ProcessMatcher matcher;
+    std::unordered_map<std::string, size_t> patternRules; // name of a glob/regex entry -> its matcher rule
+    std::vector<size_t> matchHits; // scratch buffer for matcher.match()
 };
\ No newline at end of file
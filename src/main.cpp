@@ -24,7 +24,8 @@ int main() {
     #ifdef _WIN32
         WindowsApiWrapper api;
     #else
-        LinuxApiWrapper api;
+        // Prefer the event-driven proc connector; it falls back to /proc scanning when not privileged
+        LinuxApiWrapper api(DiscoveryBackend::ProcConnector, cfg.getSettings().launchHelper);
     #endif
     
     ProcessMonitor monitor(cfg, api);
@@ -0,0 +1,99 @@
+/*
+    FakeProcfs.h - Synthetic /proc trees for benchmarking and regression-testing ProcScanner
+
+    A fake procfs is an ordinary directory that looks like /proc to ProcScanner: one numeric directory per
+    PID holding comm, stat (with a start time in field 22), cmdline and an exe symlink, plus a few
+    non-PID entries such as "self" and "meminfo" that a scan must skip. Pointing a scanner (or the
+    watchdog, through "proc_root") at it measures scanning at 10k, 100k or 1M PIDs on any Linux box
+    without starting a single process. Put it on tmpfs (/tmp or /dev/shm) so the numbers reflect the
+    scanner and not the disk.
+*/
+#pragma once
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct FakeProcfsSpec {
+    size_t count = 10000;            // number of PIDs
+    pid_t firstPid = 1;              // PIDs are firstPid, firstPid + 1, ...
+    std::vector<std::string> names;  // comm names, assigned round-robin; default "proc-<n % 100>"
+};
+
+namespace fakeprocfs {
+
+// Helper: Write a whole file relative to dirFd
+inline bool writeFileAt(int dirFd, const char* name, const char* data, size_t len) {
+    int fd = openat(dirFd, name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    bool ok = write(fd, data, len) == static_cast<ssize_t>(len);
+    close(fd);
+    return ok;
+}
+
+// Name of the nth fake process
+inline std::string nameFor(const FakeProcfsSpec& spec, size_t n) {
+    if (!spec.names.empty()) return spec.names[n % spec.names.size()];
+    return "proc-" + std::to_string(n % 100);
+}
+
+} // namespace fakeprocfs
+
+// Creates (or replaces) the entry of one fake process below root. The comm is truncated to 15 bytes
+// like the kernel does; the full name stays visible through exe and cmdline.
+inline bool writeFakeProcess(const std::string& root, pid_t pid, const std::string& name,
+                             unsigned long long startTime) {
+    std::string dir = root + "/" + std::to_string(pid);
+    if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) return false;
+    int dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) return false;
+
+    std::string comm = name.substr(0, 15);
+    std::string commFile = comm + "\n";
+    char stat[256];
+    int statLen = std::snprintf(stat, sizeof(stat),
+                                "%d (%s) S 1 %d %d 0 -1 4194560 0 0 0 0 0 0 0 0 20 0 1 0 %llu 0 0\n",
+                                static_cast<int>(pid), comm.c_str(), static_cast<int>(pid),
+                                static_cast<int>(pid), startTime);
+    std::string exe = "/usr/bin/" + name;
+    std::string cmdline = exe + '\0';
+
+    bool ok = fakeprocfs::writeFileAt(dirFd, "comm", commFile.data(), commFile.size()) &&
+              fakeprocfs::writeFileAt(dirFd, "stat", stat, static_cast<size_t>(statLen)) &&
+              fakeprocfs::writeFileAt(dirFd, "cmdline", cmdline.data(), cmdline.size());
+    unlinkat(dirFd, "exe", 0);
+    ok = ok && symlinkat(exe.c_str(), dirFd, "exe") == 0;
+    close(dirFd);
+    return ok;
+}
+
+// Removes the entry of one fake process, as if it had exited
+inline void removeFakeProcess(const std::string& root, pid_t pid) {
+    std::string dir = root + "/" + std::to_string(pid);
+    static const char* const files[] = { "comm", "stat", "cmdline", "exe" };
+    for (const char* f : files) unlink((dir + "/" + f).c_str());
+    rmdir(dir.c_str());
+}
+
+// Generates a complete fake procfs below root (which is created if needed)
+inline bool writeFakeProcfs(const std::string& root, const FakeProcfsSpec& spec) {
+    if (mkdir(root.c_str(), 0755) < 0 && errno != EEXIST) return false;
+    // Non-PID entries that a real /proc has and the scanner must ignore
+    mkdir((root + "/self").c_str(), 0755);
+    mkdir((root + "/sys").c_str(), 0755);
+    int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) return false;
+    fakeprocfs::writeFileAt(rootFd, "meminfo", "MemTotal: 0 kB\n", 15);
+    close(rootFd);
+
+    for (size_t n = 0; n < spec.count; ++n) {
+        pid_t pid = spec.firstPid + static_cast<pid_t>(n);
+        if (!writeFakeProcess(root, pid, fakeprocfs::nameFor(spec, n), 1000 + n)) return false;
+    }
+    return true;
+}
@@ -0,0 +1,30 @@
+/*
+    make_fake_procfs - command line front end for FakeProcfs.h
+
+    Usage: make_fake_procfs <dir> <count> [name...]
+
+    Writes a fake procfs with <count> PIDs to <dir>, naming the processes round-robin after the given
+    names. Run the watchdog against it with "proc_root": "<dir>" in config.json, or benchmark the
+    scanner directly with bench_ProcScanner.
+*/
+
+#include "FakeProcfs.h"
+#include <cstdlib>
+#include <iostream>
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <dir> <count> [name...]" << std::endl;
+        return 2;
+    }
+    FakeProcfsSpec spec;
+    spec.count = std::strtoul(argv[2], nullptr, 10);
+    for (int i = 3; i < argc; ++i) spec.names.push_back(argv[i]);
+
+    if (!writeFakeProcfs(argv[1], spec)) {
+        std::perror("make_fake_procfs");
+        return 1;
+    }
+    std::cout << "Wrote " << spec.count << " fake processes to " << argv[1] << std::endl;
+    return 0;
+}
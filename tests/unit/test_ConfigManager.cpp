@@ -12,6 +12,14 @@
     - Handling missing or invalid config files
     - Dynamic reload detection
     - Correct parsing of processes and foreground app
+    - Parsing of match kinds and launch executables for pattern entries
+    - Parsing of the per-entry cgroup flag and the cgroup root setting
+    - Tokenizing "args" (shell-style strings and arrays) into argv
+    - Quoting "args" arrays into a command line the platform's parser reads back unchanged
+    - Parsing "depends_on", "restart" and the start, restart and stop settings
+    - Parsing the output capture settings, which are off by default
+    - Parsing "listen" addresses (one string or a list), the "fd_store" size, the "standby" count and
+      the "readahead" flag
 */
 
 #define CATCH_CONFIG_MAIN
@@ -77,4 +85,288 @@ TEST_CASE("ConfigManager detects config reload", "[config]") {
     REQUIRE(cfg.getForegroundApp() == "mspaint.exe"); // Foreground app should match new config
 
     std::remove(path.c_str()); // Clean up: delete the test config file after test
-}
\ No newline at end of file
+}
+
+TEST_CASE("ConfigManager parses match kinds and compiles the matcher", "[config]") {
+    std::string path = "test_match.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"nginx\", \"args\": \"\" },\n"
+      << "    { \"name\": \"worker-*\", \"args\": \"--pool\", \"match\": \"glob\", \"exe\": \"worker-main\" },\n"
+      << "    { \"name\": \"job[0-9]+\", \"args\": \"\", \"match\": \"regex\" }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\"\n"
+      << "}\n";
+    f.close();
+
+    ConfigManager cfg(path);
+    auto procs = cfg.getProcesses();
+    REQUIRE(procs.size() == 3);
+    REQUIRE(procs[0].getMatchKind() == MatchKind::Exact);
+    REQUIRE(procs[0].getExe() == "nginx"); // exact entries launch their own name
+    REQUIRE(procs[1].getMatchKind() == MatchKind::Glob);
+    REQUIRE(procs[1].getExe() == "worker-main");
+    REQUIRE(procs[2].getMatchKind() == MatchKind::Regex);
+    REQUIRE(procs[2].getExe() == ""); // pattern entries without "exe" are only watched
+
+    std::vector<size_t> hits;
+    cfg.getMatcher().match("worker-3", hits);
+    REQUIRE(hits == std::vector<size_t>{ 1 });
+    hits.clear();
+    cfg.getMatcher().match("job42", hits);
+    REQUIRE(hits == std::vector<size_t>{ 2 });
+
+    std::remove(path.c_str());
+}
+TEST_CASE("ConfigManager parses cgroup entries and the cgroup root", "[config]") {
+    std::string path = "test_cgroup.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"chrome\", \"args\": \"\", \"cgroup\": true },\n"
+      << "    { \"name\": \"nano\", \"args\": \"\" }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\",\n"
+      << "  \"cgroup_root\": \"/sys/fs/cgroup/kiosk\"\n"
+      << "}\n";
+    f.close();
+
+    ConfigManager cfg(path);
+    auto procs = cfg.getProcesses();
+    REQUIRE(procs.size() == 2);
+    REQUIRE(procs[0].usesCgroup());
+    REQUIRE_FALSE(procs[1].usesCgroup()); // off unless requested
+    REQUIRE(cfg.getSettings().cgroupRoot == "/sys/fs/cgroup/kiosk");
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ConfigManager tokenizes args strings and arrays into argv", "[config]") {
+    std::string path = "test_args.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"server\", \"args\": \"--port 8080 --title 'my server' \\\"a\\\\\\\"b\\\"\" },\n"
+      << "    { \"name\": \"worker\", \"args\": [\"--name\", \"two words\", \"\"] }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\"\n"
+      << "}\n";
+    f.close();
+
+    ConfigManager cfg(path);
+    auto procs = cfg.getProcesses(); // copies: argv must point into each copy's own block
+    REQUIRE(procs.size() == 2);
+
+    REQUIRE(procs[0].getArgc() == 6);
+    char* const* argv = procs[0].getArgv();
+    REQUIRE(std::string(argv[0]) == "server"); // argv[0] is the executable
+    REQUIRE(std::string(argv[1]) == "--port");
+    REQUIRE(std::string(argv[2]) == "8080");
+    REQUIRE(std::string(argv[4]) == "my server");
+    REQUIRE(std::string(argv[5]) == "a\"b");
+    REQUIRE(argv[6] == nullptr);
+
+    REQUIRE(procs[1].getArgc() == 4);
+    argv = procs[1].getArgv();
+    REQUIRE(std::string(argv[2]) == "two words");
+    REQUIRE(std::string(argv[3]) == "");
+    REQUIRE(procs[1].getArgs() == "--name \"two words\" \"\""); // quoted command line for Windows
+
+    std::remove(path.c_str());
+}
+
+// Helper: Split the arguments of a Windows command line like CommandLineToArgvW: 2n backslashes before a '"'
+// become n and the quote opens or closes a quoted part, 2n+1 become n and a literal '"', other backslashes
+// are literal, and "" inside a quoted part is a literal '"'
+std::vector<std::string> split_windows_command_line(const std::string& line) {
+    std::vector<std::string> words;
+    std::string word;
+    bool inWord = false;
+    bool inQuotes = false;
+    size_t i = 0;
+    while (i < line.size()) {
+        char c = line[i];
+        if (!inQuotes && (c == ' ' || c == '\t')) {
+            if (inWord) words.push_back(word);
+            word.clear();
+            inWord = false;
+            ++i;
+        } else if (c == '\\') {
+            size_t n = 0;
+            while (i < line.size() && line[i] == '\\') {
+                ++n;
+                ++i;
+            }
+            inWord = true;
+            if (i < line.size() && line[i] == '"') {
+                word.append(n / 2, '\\');
+                if (n % 2 == 1) {
+                    word += '"';
+                    ++i;
+                }
+            } else {
+                word.append(n, '\\');
+            }
+        } else if (c == '"') {
+            inWord = true;
+            if (inQuotes && i + 1 < line.size() && line[i + 1] == '"') {
+                word += '"';
+                i += 2;
+            } else {
+                inQuotes = !inQuotes;
+                ++i;
+            }
+        } else {
+            inWord = true;
+            word += c;
+            ++i;
+        }
+    }
+    if (inWord) words.push_back(word);
+    return words;
+}
+
+TEST_CASE("ConfigManager quotes args arrays so that they round-trip through the command line", "[config]") {
+    std::string path = "test_args_quoting.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"tool\", \"args\": [\"C:\\\\dir\\\\x.txt\", \"say \\\"hi\\\"\",\n"
+      << "      \"C:\\\\my dir\\\\\", \"a\\\\\\\"b\", \"$HOME `id`\", \"\"] }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\"\n"
+      << "}\n";
+    f.close();
+
+    std::vector<std::string> expected;
+    expected.push_back("C:\\dir\\x.txt"); // backslashes are path separators, not escapes
+    expected.push_back("say \"hi\"");
+    expected.push_back("C:\\my dir\\");   // a trailing backslash right before the closing quote
+    expected.push_back("a\\\"b");          // a backslash right before an embedded quote
+    expected.push_back("$HOME `id`");
+    expected.push_back("");
+
+    ConfigManager cfg(path);
+    const auto& procs = cfg.getProcesses();
+    REQUIRE(procs.size() == 1);
+    REQUIRE(procs[0].getArgc() == expected.size() + 1);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        REQUIRE(std::string(procs[0].getArgv()[i + 1]) == expected[i]);
+    }
+
+    // The command line handed to CreateProcess on Windows, and to the shell-style parser elsewhere
+#ifdef _WIN32
+    REQUIRE(split_windows_command_line(procs[0].getArgs()) == expected);
+    REQUIRE(procs[0].getArgs().find("C:\\dir\\x.txt") != std::string::npos); // left as written
+#else
+    std::vector<std::string> words;
+    REQUIRE(ProcessInfo::splitCommandLine(procs[0].getArgs(), words));
+    REQUIRE(words == expected);
+#endif
+
+    // The Windows quoting itself, checked on every platform
+    std::string line;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (i > 0) line += ' ';
+        line += ProcessInfo::quoteWindowsArg(expected[i]);
+    }
+    REQUIRE(line == "C:\\dir\\x.txt \"say \\\"hi\\\"\" \"C:\\my dir\\\\\" \"a\\\\\\\"b\" \"$HOME `id`\" \"\"");
+    REQUIRE(split_windows_command_line(line) == expected);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ConfigManager parses dependencies, restart policies and their settings", "[config]") {
+    std::string path = "test_depends.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"db\", \"args\": \"\" },\n"
+      << "    { \"name\": \"api\", \"args\": \"\", \"depends_on\": \"db\", \"restart\": \"on-failure\" },\n"
+      << "    { \"name\": \"web\", \"args\": \"\", \"depends_on\": [\"db\", \"api\"] }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\",\n"
+      << "  \"start_concurrency\": 4,\n"
+      << "  \"restart_delay_ms\": 250,\n"
+      << "  \"restart_burst\": 0,\n"
+      << "  \"stop_grace_ms\": 1500\n"
+      << "}\n";
+    f.close();
+
+    ConfigManager cfg(path);
+    auto procs = cfg.getProcesses();
+    REQUIRE(procs.size() == 3);
+    REQUIRE(procs[0].getDependsOn().empty());
+    REQUIRE(procs[1].getDependsOn() == std::vector<std::string>({ "db" }));
+    REQUIRE(procs[2].getDependsOn() == std::vector<std::string>({ "db", "api" }));
+    REQUIRE(procs[0].getRestartPolicy() == RestartPolicy::Always); // the default
+    REQUIRE(procs[1].getRestartPolicy() == RestartPolicy::OnFailure);
+    REQUIRE(cfg.getSettings().startConcurrency == 4);
+    REQUIRE(cfg.getSettings().restartDelayMs == 250);
+    REQUIRE(cfg.getSettings().restartDelayMaxMs == 60000);
+    REQUIRE(cfg.getSettings().restartBurst == 0);
+    REQUIRE(cfg.getSettings().stopGraceMs == 1500);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ConfigManager parses the output capture settings", "[config]") {
+    std::string path = "test_logs.json";
+    write_test_config(path, "notepad.exe", "", "");
+    {
+        ConfigManager cfg(path);
+        REQUIRE(cfg.getSettings().logDir.empty()); // children inherit stdout unless a log_dir is set
+        REQUIRE(cfg.getSettings().logMaxBytes == 1024 * 1024);
+        REQUIRE(cfg.getSettings().logTailBytes == 4096);
+    }
+
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [ { \"name\": \"notepad.exe\", \"args\": \"\" } ],\n"
+      << "  \"foreground\": \"\",\n"
+      << "  \"log_dir\": \"/var/log/watchdog\",\n"
+      << "  \"log_max_bytes\": 65536,\n"
+      << "  \"log_tail_bytes\": 0\n"
+      << "}\n";
+    f.close();
+    ConfigManager cfg(path);
+    REQUIRE(cfg.getSettings().logDir == "/var/log/watchdog");
+    REQUIRE(cfg.getSettings().logMaxBytes == 65536);
+    REQUIRE(cfg.getSettings().logTailBytes == 0);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("ConfigManager parses the per-entry restart options", "[config]") {
+    std::string path = "test_listen.json";
+    std::ofstream f(path);
+    f << "{\n"
+      << "  \"processes\": [\n"
+      << "    { \"name\": \"worker\", \"args\": \"\" },\n"
+      << "    { \"name\": \"web\", \"args\": \"\", \"listen\": \"8080\", \"fd_store\": 16, \"standby\": 2,\n"
+      << "      \"readahead\": true },\n"
+      << "    { \"name\": \"dns\", \"args\": \"\", \"listen\": [\"udp:127.0.0.1:53\", \"/run/dns.sock\"] }\n"
+      << "  ],\n"
+      << "  \"foreground\": \"\"\n"
+      << "}\n";
+    f.close();
+
+    ConfigManager cfg(path);
+    auto procs = cfg.getProcesses();
+    REQUIRE(procs.size() == 3);
+    REQUIRE(procs[0].getListen().empty());
+    REQUIRE(procs[1].getListen() == std::vector<std::string>({ "8080" }));
+    REQUIRE(procs[2].getListen() == std::vector<std::string>({ "udp:127.0.0.1:53", "/run/dns.sock" }));
+    REQUIRE(procs[0].getFdStore() == 0); // no fd store by default
+    REQUIRE(procs[1].getFdStore() == 16);
+    ProcessInfo copy = procs[1];
+    REQUIRE(copy.getListen() == procs[1].getListen());
+    REQUIRE(copy.getFdStore() == 16);
+    REQUIRE(procs[0].getStandby() == 0); // no standby instances by default
+    REQUIRE(copy.getStandby() == 2);
+    REQUIRE(!procs[0].usesReadahead());
+    REQUIRE(copy.usesReadahead());
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,227 @@
+/*
+    Unit Tests for LinuxApiWrapper (Linux only)
+
+    Unlike the other tests these start real processes: the test binary runs itself as the monitored
+    service (see childMain), so nothing else needs to be installed. Build it with the Linux sources:
+
+        g++ -std=c++17 -Isrc -Itests/unit tests/unit/test_LinuxApiWrapper.cpp src/LinuxApiWrapper.cpp
+            src/OSApiWrapper.cpp src/ConfigManager.cpp src/ProcessMatcher.cpp src/CgroupManager.cpp
+            src/ExecPrefetch.cpp src/LaunchHelper.cpp src/OutputCapture.cpp src/ListenSockets.cpp
+            src/NotifySocket.cpp src/ProcConnector.cpp src/ProcScanner.cpp src/ProcBatchReader.cpp
+            -pthread -o build/test_LinuxApiWrapper
+
+    These tests cover:
+    - Fds a service stores right before it exits reaching its next process, even when the exit of another
+      child is handled first and reaps it before its message is read
+    - The exit of a cgroup entry's last process being noticed after "cgroup_root" changed (skipped without a
+      writable cgroup2 mount)
+*/
+
+#define CATCH_CONFIG_RUNNER
+#include "catch.hpp"
+#include "ConfigManager.h"
+#include "LinuxApiWrapper.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+#include <sys/un.h>
+#include <linux/magic.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Dummy logger for unit tests:
+// This prevents linker errors when LinuxApiWrapper calls logToWindowsEventLog.
+void logToWindowsEventLog(const std::string&, int) {}
+
+static const char* kChildFlag = "--fd-store-child";
+
+// Helper: The services. With "-" as resultPath the child just exits, with "fork" it leaves a process behind
+// that exits 300 ms later. Otherwise, without stored fds it hands
+// a pipe to the fd store as "warm" and exits at once; started again, it writes the names of the fds it got
+// to resultPath
+static int childMain(const char* resultPath) {
+    if (std::strcmp(resultPath, "-") == 0) return 0;
+    if (std::strcmp(resultPath, "fork") == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            usleep(300000);
+            _exit(0);
+        }
+        return pid < 0 ? 5 : 0;
+    }
+    const char* names = std::getenv("LISTEN_FDNAMES");
+    if (names != nullptr) {
+        std::ofstream(resultPath) << names;
+        return 0;
+    }
+    const char* address = std::getenv("NOTIFY_SOCKET");
+    if (address == nullptr) return 2;
+    int pipeFds[2];
+    int sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock < 0 || pipe(pipeFds) < 0) return 3;
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, address, sizeof(addr.sun_path) - 1);
+    if (addr.sun_path[0] == '@') addr.sun_path[0] = '\0';
+    socklen_t length = static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + std::strlen(address));
+
+    const char text[] = "FDSTORE=1\nFDNAME=warm";
+    iovec iov = { const_cast<char*>(text), sizeof(text) - 1 };
+    union {
+        cmsghdr align;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    msghdr msg;
+    std::memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = length;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+    cmsghdr* c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(c), &pipeFds[0], sizeof(int));
+    usleep(50000); // after the other child has exited
+    return sendmsg(sock, &msg, 0) < 0 ? 4 : 0;
+}
+
+static std::string selfPath;
+
+// Helper: Runs the event loop until count processes have exited and been reported. True if they did, all
+// with status 0
+static bool waitForExits(LinuxApiWrapper& api, size_t count) {
+    std::vector<ProcessExit> exits;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (exits.size() < count && std::chrono::steady_clock::now() < deadline) {
+        api.waitForEvents(100);
+        api.beginTick();
+        std::vector<ProcessExit> more = api.takeExitedProcesses();
+        api.endTick();
+        exits.insert(exits.end(), more.begin(), more.end());
+    }
+    for (size_t i = 0; i < exits.size(); ++i) {
+        if (exits[i].exitCode != 0 || exits[i].signal != 0) return false;
+    }
+    return exits.size() == count;
+}
+
+TEST_CASE("LinuxApiWrapper keeps fds stored right before the service exits", "[linux]") {
+    char dir[] = "/tmp/watchdog-test-XXXXXX";
+    REQUIRE(mkdtemp(dir) != nullptr);
+    const std::string configPath = std::string(dir) + "/config.json";
+    const std::string resultPath = std::string(dir) + "/result";
+    std::ofstream(configPath) << "{ \"processes\": ["
+                              << " { \"name\": \"quick-exit\", \"exe\": \"" << selfPath << "\", \"args\": [\""
+                              << kChildFlag << "\", \"-\"] },"
+                              << " { \"name\": \"fdstore-child\", \"exe\": \"" << selfPath << "\", \"args\": [\""
+                              << kChildFlag << "\", \"" << resultPath << "\"], \"fd_store\": 4 } ],"
+                              << " \"foreground\": \"\" }";
+    ConfigManager cfg(configPath);
+    LinuxApiWrapper api;
+    api.configure(cfg);
+    const ProcessInfo& quick = cfg.getProcesses()[0];
+    const ProcessInfo& info = cfg.getProcesses()[1];
+
+    // The exit of the other child comes first in the batch of events. Reaping it collects the fd store
+    // child as well, whose message is still waiting
+    api.beginTick();
+    REQUIRE(api.startService(quick) == LaunchResult::Started);
+    REQUIRE(api.startService(info) == LaunchResult::Started);
+    api.endTick();
+    usleep(300000);
+    REQUIRE(waitForExits(api, 2));
+
+    // Its successor gets the stored pipe
+    api.beginTick();
+    REQUIRE(api.startService(info) == LaunchResult::Started);
+    api.endTick();
+    REQUIRE(waitForExits(api, 1));
+    std::ifstream result(resultPath);
+    std::stringstream names;
+    names << result.rdbuf();
+    REQUIRE(names.str() == "warm");
+
+    unlink(resultPath.c_str());
+    unlink(configPath.c_str());
+    rmdir(dir);
+}
+
+// Helper: Directory on a cgroup2 mount to create the test's cgroup roots in, or "" if there is none
+static std::string cgroupBase() {
+    const char* mounts[] = { "/sys/fs/cgroup/unified", "/sys/fs/cgroup" };
+    for (const char* mount : mounts) {
+        struct statfs fs;
+        if (statfs(mount, &fs) == 0 && fs.f_type == CGROUP2_SUPER_MAGIC && access(mount, W_OK) == 0) return mount;
+    }
+    return "";
+}
+
+TEST_CASE("LinuxApiWrapper notices cgroup exits after the cgroup root changed", "[linux]") {
+    const std::string base = cgroupBase();
+    if (base.empty()) {
+        WARN("No writable cgroup2 mount, skipping");
+        return;
+    }
+    char dir[] = "/tmp/watchdog-test-XXXXXX";
+    REQUIRE(mkdtemp(dir) != nullptr);
+    const std::string configPath = std::string(dir) + "/config.json";
+    const std::string firstRoot = base + "/watchdog-test-first";
+    const std::string secondRoot = base + "/watchdog-test-second";
+    auto writeConfig = [&](const std::string& root, bool cgroup) {
+        std::ofstream(configPath) << "{ \"processes\": ["
+                                  << " { \"name\": \"cg-child\", \"exe\": \"" << selfPath << "\", \"args\": [\""
+                                  << kChildFlag << "\", \"fork\"], \"cgroup\": " << (cgroup ? "true" : "false")
+                                  << " } ], \"cgroup_root\": \"" << root << "\", \"foreground\": \"\" }";
+    };
+    writeConfig(firstRoot, true);
+    ConfigManager first(configPath);
+    writeConfig(secondRoot, true);
+    ConfigManager second(configPath);
+    writeConfig(secondRoot, false);
+    ConfigManager none(configPath);
+
+    LinuxApiWrapper api;
+    api.configure(first);
+    api.configure(second); // closes the first inotify fd; the second one usually gets its number
+    REQUIRE(!api.isProcessRunning("cg-child"));
+
+    // The service itself exits at once and is reaped; only the cgroup event tells that the process it
+    // left behind is gone
+    api.beginTick();
+    REQUIRE(api.startService(second.getProcesses()[0]) == LaunchResult::Started);
+    api.endTick();
+    REQUIRE(waitForExits(api, 1));
+    REQUIRE(api.isProcessRunning("cg-child"));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (api.isProcessRunning("cg-child") && std::chrono::steady_clock::now() < deadline) {
+        api.waitForEvents(100);
+    }
+    REQUIRE(!api.isProcessRunning("cg-child"));
+
+    api.configure(none); // removes the now empty cgroup of the service
+    rmdir((firstRoot + "/cg-child").c_str());
+    rmdir(firstRoot.c_str());
+    rmdir(secondRoot.c_str());
+    unlink(configPath.c_str());
+    rmdir(dir);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 3 && std::strcmp(argv[1], kChildFlag) == 0) return childMain(argv[2]);
+    char path[4096];
+    ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (n <= 0) return 1;
+    selfPath.assign(path, static_cast<size_t>(n));
+    return Catch::Session().run(argc, argv);
+}
@@ -0,0 +1,108 @@
+/*
+    Unit Tests for ProcessMatcher
+
+    ProcessMatcher classifies a process name against all configured entries at once:
+    exact names through a hash map, globs and regexes through one combined DFA, and
+    regexes the DFA cannot express through std::regex.
+
+    These tests cover:
+    - Exact, glob and regex entries, alone and mixed
+    - Several entries matching the same name
+    - Regex features that need the std::regex fallback
+    - Invalid regexes being ignored
+    - Deciding whether a truncated name is worth resolving in full
+*/
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "ProcessMatcher.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Dummy logger for unit tests:
+// This prevents linker errors when ProcessMatcher calls logToWindowsEventLog.
+void logToWindowsEventLog(const std::string&, unsigned short) {}
+
+// Helper: Names of all entries matching a process name, sorted
+static std::vector<std::string> matches(const ProcessMatcher& m, const std::string& name) {
+    std::vector<size_t> hits;
+    m.match(name, hits);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < hits.size(); ++i) names.push_back(m.ruleName(hits[i]));
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+TEST_CASE("ProcessMatcher matches exact names", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("nginx", ""), ProcessInfo("redis-server", "") });
+    REQUIRE(matches(m, "nginx") == std::vector<std::string>{ "nginx" });
+    REQUIRE(matches(m, "redis-server") == std::vector<std::string>{ "redis-server" });
+    REQUIRE(matches(m, "nginx2").empty());
+    REQUIRE(m.findRule("nginx") == 0);
+    REQUIRE(m.findRule("apache") == -1);
+}
+
+TEST_CASE("ProcessMatcher matches globs", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("worker-*", "", MatchKind::Glob, ""),
+                       ProcessInfo("db?", "", MatchKind::Glob, ""),
+                       ProcessInfo("job[0-9]", "", MatchKind::Glob, ""),
+                       ProcessInfo("tmp[!a-z]", "", MatchKind::Glob, "") });
+    REQUIRE(matches(m, "worker-") == std::vector<std::string>{ "worker-*" });
+    REQUIRE(matches(m, "worker-17") == std::vector<std::string>{ "worker-*" });
+    REQUIRE(matches(m, "worker").empty());
+    REQUIRE(matches(m, "db1") == std::vector<std::string>{ "db?" });
+    REQUIRE(matches(m, "db12").empty());
+    REQUIRE(matches(m, "job7") == std::vector<std::string>{ "job[0-9]" });
+    REQUIRE(matches(m, "jobx").empty());
+    REQUIRE(matches(m, "tmp1") == std::vector<std::string>{ "tmp[!a-z]" });
+    REQUIRE(matches(m, "tmpa").empty());
+}
+
+TEST_CASE("ProcessMatcher matches whole names against regexes", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("^worker-[0-9]+$", "", MatchKind::Regex, ""),
+                       ProcessInfo("(php|python)[0-9.]*", "", MatchKind::Regex, ""),
+                       ProcessInfo("a{2,3}", "", MatchKind::Regex, ""),
+                       ProcessInfo("\\w+\\.sh", "", MatchKind::Regex, "") });
+    REQUIRE(matches(m, "worker-42") == std::vector<std::string>{ "^worker-[0-9]+$" });
+    REQUIRE(matches(m, "worker-").empty());
+    REQUIRE(matches(m, "my-worker-1").empty());
+    REQUIRE(matches(m, "python3.11") == std::vector<std::string>{ "(php|python)[0-9.]*" });
+    REQUIRE(matches(m, "php") == std::vector<std::string>{ "(php|python)[0-9.]*" });
+    REQUIRE(matches(m, "aa") == std::vector<std::string>{ "a{2,3}" });
+    REQUIRE(matches(m, "aaaa").empty());
+    REQUIRE(matches(m, "run_me.sh") == std::vector<std::string>{ "\\w+\\.sh" });
+    REQUIRE(matches(m, "run_mexsh").empty());
+}
+
+TEST_CASE("ProcessMatcher reports every entry that matches", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("worker-1", ""),
+                       ProcessInfo("worker-*", "", MatchKind::Glob, ""),
+                       ProcessInfo("w.*1", "", MatchKind::Regex, "") });
+    REQUIRE(matches(m, "worker-1") == std::vector<std::string>{ "w.*1", "worker-*", "worker-1" });
+    REQUIRE(matches(m, "worker-2") == std::vector<std::string>{ "worker-*" });
+}
+
+TEST_CASE("ProcessMatcher falls back to std::regex and ignores invalid regexes", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("(ab)\\1", "", MatchKind::Regex, ""),
+                       ProcessInfo("broken[", "", MatchKind::Regex, ""),
+                       ProcessInfo("ok", "") });
+    REQUIRE(matches(m, "abab") == std::vector<std::string>{ "(ab)\\1" });
+    REQUIRE(matches(m, "abcd").empty());
+    REQUIRE(matches(m, "broken[").empty());
+    REQUIRE(matches(m, "ok") == std::vector<std::string>{ "ok" });
+}
+
+TEST_CASE("ProcessMatcher tells whether a truncated name could match a longer one", "[matcher]") {
+    ProcessMatcher m({ ProcessInfo("gnome-terminal-server", ""),
+                       ProcessInfo("nginx", ""),
+                       ProcessInfo("long-running-*", "", MatchKind::Glob, ""),
+                       ProcessInfo("batch-[0-9]{2}", "", MatchKind::Regex, "") });
+    REQUIRE(m.mayMatchLonger("gnome-terminal-"));  // prefix of an exact name
+    REQUIRE_FALSE(m.mayMatchLonger("gnome-shell-cal"));
+    REQUIRE_FALSE(m.mayMatchLonger("nginx"));      // exact name itself, nothing longer
+    REQUIRE(m.mayMatchLonger("long-running-jo")); // glob can continue
+    REQUIRE(m.mayMatchLonger("batch-1"));
+    REQUIRE_FALSE(m.mayMatchLonger("batch-12"));   // regex is complete, cannot grow
+    REQUIRE_FALSE(m.mayMatchLonger("something-else-"));
+}
@@ -14,6 +14,8 @@
     - Restarts processes if they are stopped
     - Starts new processes when added to config
     - Stops monitoring (and does not restart) processes removed from config
+    - Starts prerequisites ("depends_on") before the entries that need them
+    - Does not retry an entry whose launch reported that it can never succeed
 */
 /*
   OOP Principles Applied
@@ -46,6 +48,9 @@ public:
     std::vector<std::string> killed;
     std::vector<std::string> checked;
     std::vector<std::string> running; // Simulate running processes
+    std::vector<std::string> missing; // Simulate entries whose executable does not exist
+    int ticksBegun = 0;
+    int ticksEnded = 0;
 
     bool isProcessRunning(const std::string& name) override {
         checked.push_back(name);
@@ -55,12 +60,21 @@ public:
         started.push_back(name);
         running.push_back(name);
     }
+    LaunchResult startService(const ProcessInfo& info) override {
+        if (std::find(missing.begin(), missing.end(), info.getName()) == missing.end()) {
+            return OSApiWrapper::startService(info);
+        }
+        started.push_back(info.getName());
+        return LaunchResult::Unlaunchable;
+    }
     void killProcess(const std::string& name) override {
         killed.push_back(name);
         running.erase(std::remove(running.begin(), running.end(), name), running.end());
     }
     void bringToForeground(const std::string&) override {}
     bool isProcessInForeground(const std::string&) override { return true; }    
+    void beginTick() override { ticksBegun++; }
+    void endTick() override { ticksEnded++; }
 };
 
 class MockConfig : public ConfigManager {
@@ -154,4 +168,46 @@ TEST_CASE("ProcessMonitor stops monitoring removed processes", "[ProcessMonitor]
 
     // Only notepad.exe should be checked/restarted
     REQUIRE(std::find(api.started.begin(), api.started.end(), "mspaint.exe") == api.started.end());
-}
\ No newline at end of file
+}
+
+TEST_CASE("ProcessMonitor brackets every tick with beginTick/endTick", "[ProcessMonitor]") {
+    MockApi api;
+    std::vector<ProcessInfo> procs = { ProcessInfo("notepad.exe", ""), ProcessInfo("mspaint.exe", "") };
+    MockConfig cfg(procs, "notepad.exe");
+    ProcessMonitor monitor(cfg, api);
+
+    bool ran = false;
+    monitor.run([&ran]() { if (ran) return false; ran = true; return true; });
+
+    // One snapshot per tick, no matter how many processes are checked
+    REQUIRE(api.ticksBegun == 1);
+    REQUIRE(api.ticksEnded == 1);
+    REQUIRE(api.checked.size() == 2);
+}
+TEST_CASE("ProcessMonitor starts prerequisites first", "[ProcessMonitor]") {
+    MockApi api;
+    std::vector<ProcessInfo> procs = { ProcessInfo("web", ""), ProcessInfo("db", "") };
+    procs[0].setDependsOn({ "db" });
+    MockConfig cfg(procs, "");
+    ProcessMonitor monitor(cfg, api);
+
+    bool ran = false;
+    monitor.run([&ran]() { if (ran) return false; ran = true; return true; });
+
+    REQUIRE(api.started == std::vector<std::string>({ "db", "web" }));
+}
+
+
+TEST_CASE("ProcessMonitor does not retry entries that cannot be launched", "[ProcessMonitor]") {
+    MockApi api;
+    api.missing = { "mspaint.exe" };
+    std::vector<ProcessInfo> procs = { ProcessInfo("notepad.exe", ""), ProcessInfo("mspaint.exe", "") };
+    MockConfig cfg(procs, "");
+    ProcessMonitor monitor(cfg, api);
+
+    int ticks = 0;
+    monitor.run([&ticks]() { return ticks++ < 3; });
+
+    REQUIRE(std::count(api.started.begin(), api.started.end(), "mspaint.exe") == 1);
+    REQUIRE(std::count(api.started.begin(), api.started.end(), "notepad.exe") == 1);
+}
@@ -0,0 +1,314 @@
+/*
+    Unit Tests for StartupScheduler
+
+    StartupScheduler decides which monitored entries to start in a tick: prerequisites ("depends_on")
+    first, independent entries together, and no more than a fixed number of entries starting at once.
+    The tests drive it with a fake process table instead of real processes.
+
+    These tests cover:
+    - Topological order that keeps the config order of independent entries
+    - A whole dependency chain coming up within one round when each start succeeds at once
+    - Dependents waiting while their prerequisite is started but not yet running
+    - The limit on entries starting at once, and the start timeout that frees a slot
+    - Unknown dependencies and dependency cycles being ignored instead of blocking startup
+    - A single crash restarted in the same round, growing restart delays for repeated ones, the burst
+      limit that marks an entry failed, and "on-failure" entries
+    - Failed launches retried after the restart delay, unlaunchable entries not retried at all
+*/
+
+#define CATCH_CONFIG_MAIN
+#include "catch.hpp"
+#include "StartupScheduler.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Dummy logger for unit tests:
+// This prevents linker errors when StartupScheduler calls logToWindowsEventLog.
+void logToWindowsEventLog(const std::string&, unsigned short) {}
+
+// Helper: A process table; started entries come up immediately unless they are listed in slow, or their
+// launch is made to fail through results
+struct FakeTable {
+    std::set<std::string> running;
+    std::set<std::string> slow;
+    std::map<std::string, LaunchResult> results;
+    std::vector<std::string> started;
+    int checks = 0;
+
+    void run(StartupScheduler& s, StartupScheduler::Clock::time_point now) {
+        s.run([this](const std::string& name) { ++checks; return running.count(name) > 0; },
+              [this](const ProcessInfo& info) -> LaunchResult {
+                  started.push_back(info.getName());
+                  std::map<std::string, LaunchResult>::const_iterator it = results.find(info.getName());
+                  if (it != results.end()) return it->second;
+                  if (!slow.count(info.getName())) running.insert(info.getName());
+                  return LaunchResult::Started;
+              },
+              now);
+    }
+};
+
+// Helper: Settings with the given start concurrency and no restart delays or burst limit
+static WatchdogSettings limits(unsigned maxStarting) {
+    WatchdogSettings settings;
+    settings.startConcurrency = maxStarting;
+    settings.restartDelayMs = 0;
+    settings.restartBurst = 0;
+    return settings;
+}
+
+// Helper: An entry with prerequisites
+static ProcessInfo entry(const std::string& name, const std::vector<std::string>& deps) {
+    ProcessInfo info(name, "");
+    info.setDependsOn(deps);
+    return info;
+}
+
+TEST_CASE("StartupScheduler orders prerequisites first and keeps config order otherwise", "[scheduler]") {
+    StartupScheduler s;
+    s.configure({ entry("web", { "db", "cache" }), entry("cache", {}), entry("db", {}), entry("cron", {}) }, limits(0));
+    // web is ready as soon as cache and db are placed and comes before cron in the config
+    REQUIRE(s.order() == std::vector<std::string>({ "cache", "db", "web", "cron" }));
+}
+
+TEST_CASE("StartupScheduler brings up a dependency chain in one round", "[scheduler]") {
+    StartupScheduler s;
+    s.configure({ entry("app", { "api" }), entry("api", { "db" }), entry("db", {}) }, limits(16));
+    FakeTable t;
+    t.run(s, StartupScheduler::Clock::now());
+    REQUIRE(t.started == std::vector<std::string>({ "db", "api", "app" }));
+
+    // Once everything runs, a round asks about every entry exactly once
+    t.checks = 0;
+    t.run(s, StartupScheduler::Clock::now());
+    REQUIRE(t.started.size() == 3);
+    REQUIRE(t.checks == 3);
+}
+
+TEST_CASE("StartupScheduler holds dependents until their prerequisite runs", "[scheduler]") {
+    StartupScheduler s;
+    s.configure({ entry("db", {}), entry("api", { "db" }), entry("tool", {}) }, limits(16));
+    FakeTable t;
+    t.slow.insert("db");
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+
+    t.run(s, now);
+    REQUIRE(t.started == std::vector<std::string>({ "db", "tool" }));
+
+    // Still starting: not started again, and api keeps waiting
+    t.run(s, now + std::chrono::seconds(2));
+    REQUIRE(t.started.size() == 2);
+
+    t.running.insert("db");
+    t.run(s, now + std::chrono::seconds(4));
+    REQUIRE(t.started == std::vector<std::string>({ "db", "tool", "api" }));
+}
+
+TEST_CASE("StartupScheduler limits how many entries start at once", "[scheduler]") {
+    StartupScheduler s;
+    std::vector<ProcessInfo> procs;
+    for (int i = 0; i < 5; ++i) procs.push_back(ProcessInfo("svc" + std::to_string(i), ""));
+    s.configure(procs, limits(2));
+    FakeTable t;
+    for (int i = 0; i < 5; ++i) t.slow.insert("svc" + std::to_string(i));
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+
+    t.run(s, now);
+    REQUIRE(t.started == std::vector<std::string>({ "svc0", "svc1" }));
+
+    // svc0 comes up and frees its slot
+    t.running.insert("svc0");
+    t.run(s, now + std::chrono::seconds(2));
+    REQUIRE(t.started == std::vector<std::string>({ "svc0", "svc1", "svc2" }));
+
+    // Entries that never come up give their slots back after the start timeout and are retried
+    // (right away, as these settings have no restart delay)
+    t.run(s, now + std::chrono::seconds(StartupScheduler::kStartTimeoutSeconds + 2));
+    REQUIRE(t.started.size() == 5);
+    REQUIRE(t.started[3] == "svc1");
+    REQUIRE(t.started[4] == "svc2");
+}
+
+TEST_CASE("StartupScheduler ignores unknown dependencies and cycles", "[scheduler]") {
+    StartupScheduler s;
+    s.configure({ entry("a", { "b" }), entry("b", { "a" }), entry("c", { "missing" }), entry("d", { "a" }) }, limits(0));
+    REQUIRE(s.order() == std::vector<std::string>({ "c", "a", "b", "d" }));
+
+    FakeTable t;
+    t.run(s, StartupScheduler::Clock::now());
+    REQUIRE(t.started == std::vector<std::string>({ "c", "a", "b", "d" }));
+
+    // Only a's dependency on b is dropped: b and d still wait for a
+    StartupScheduler s2;
+    s2.configure({ entry("a", { "b" }), entry("b", { "a" }), entry("d", { "a" }) }, limits(0));
+    FakeTable t2;
+    t2.slow.insert("a");
+    t2.run(s2, StartupScheduler::Clock::now());
+    REQUIRE(t2.started == std::vector<std::string>({ "a" }));
+}
+
+TEST_CASE("StartupScheduler passes watch-only entries on without holding a slot", "[scheduler]") {
+    StartupScheduler s;
+    s.configure({ ProcessInfo("worker-*", "", MatchKind::Glob, ""), ProcessInfo("svc", "") }, limits(1));
+    FakeTable t;
+    t.slow.insert("worker-*");
+    t.slow.insert("svc");
+    t.run(s, StartupScheduler::Clock::now());
+    REQUIRE(t.started == std::vector<std::string>({ "worker-*", "svc" }));
+}
+
+TEST_CASE("StartupScheduler backs off an entry that keeps dying", "[scheduler]") {
+    StartupScheduler s;
+    WatchdogSettings settings = limits(0);
+    settings.restartDelayMs = 1000;
+    settings.restartDelayMaxMs = 4000;
+    s.configure({ ProcessInfo("crasher", "") }, settings);
+    FakeTable t;
+    t.slow.insert("crasher"); // never seen running
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+
+    t.run(s, now);
+    REQUIRE(t.started.size() == 1);
+
+    // The first stop is restarted right away
+    s.noteExit("crasher", false);
+    t.run(s, now);
+    REQUIRE(t.started.size() == 2);
+    REQUIRE(s.nextRetryAt(now) == StartupScheduler::Clock::time_point::max());
+
+    // Each further stop doubles the delay (half of it jittered): 0.5-1 s, 1-2 s, 2-4 s, then capped at 2-4 s
+    const int delays[] = { 1000, 2000, 4000, 4000 };
+    for (int i = 0; i < 4; ++i) {
+        s.noteExit("crasher", false);
+        t.run(s, now);
+        REQUIRE(t.started.size() == size_t(i + 2));
+        REQUIRE(s.nextRetryAt(now) >= now + std::chrono::milliseconds(delays[i] / 2));
+        REQUIRE(s.nextRetryAt(now) <= now + std::chrono::milliseconds(delays[i]));
+        t.run(s, now + std::chrono::milliseconds(delays[i] / 2 - 1));
+        REQUIRE(t.started.size() == size_t(i + 2));
+        now += std::chrono::milliseconds(delays[i]);
+        t.run(s, now);
+        REQUIRE(t.started.size() == size_t(i + 3));
+    }
+}
+
+TEST_CASE("StartupScheduler restarts a single crash in the same round", "[scheduler]") {
+    StartupScheduler s;
+    WatchdogSettings settings = limits(0);
+    settings.restartDelayMs = 1000;
+    settings.restartBurstWindow = 60;
+    s.configure({ ProcessInfo("svc", "") }, settings);
+    FakeTable t;
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+    t.run(s, now);
+    t.run(s, now + std::chrono::seconds(2));
+    REQUIRE(t.started.size() == 1);
+
+    // The exit is reported and the entry started again within one round, without a delay
+    now += std::chrono::seconds(4);
+    t.running.clear();
+    s.noteExit("svc", false);
+    t.run(s, now);
+    REQUIRE(t.started.size() == 2);
+
+    // After a stable run the next crash counts as a first one again
+    t.run(s, now + std::chrono::seconds(1));
+    now += std::chrono::seconds(62);
+    t.run(s, now);
+    t.running.clear();
+    s.noteExit("svc", false);
+    t.run(s, now);
+    REQUIRE(t.started.size() == 3);
+}
+
+TEST_CASE("StartupScheduler marks an entry failed after too many starts", "[scheduler]") {
+    StartupScheduler s;
+    WatchdogSettings settings = limits(0);
+    settings.restartBurst = 3;
+    settings.restartBurstWindow = 60;
+    s.configure({ ProcessInfo("crasher", ""), ProcessInfo("fine", "") }, settings);
+    FakeTable t;
+    t.slow.insert("crasher");
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+
+    for (int i = 0; i < 5; ++i) {
+        t.run(s, now + std::chrono::seconds(i));
+        s.noteExit("crasher", false);
+    }
+    REQUIRE(std::count(t.started.begin(), t.started.end(), "crasher") == 3);
+    REQUIRE(s.hasFailed("crasher"));
+    REQUIRE_FALSE(s.hasFailed("fine"));
+
+    // A reload gives it another chance
+    s.configure({ ProcessInfo("crasher", ""), ProcessInfo("fine", "") }, settings);
+    REQUIRE_FALSE(s.hasFailed("crasher"));
+    t.run(s, now + std::chrono::seconds(10));
+    REQUIRE(std::count(t.started.begin(), t.started.end(), "crasher") == 4);
+}
+
+TEST_CASE("StartupScheduler restarts on-failure entries only after a failure", "[scheduler]") {
+    StartupScheduler s;
+    ProcessInfo job("job", "");
+    job.setRestartPolicy(RestartPolicy::OnFailure);
+    s.configure({ job, ProcessInfo("daemon", "") }, limits(0));
+    FakeTable t;
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+    t.run(s, now);
+    REQUIRE(t.started.size() == 2);
+
+    // Both exit cleanly: only the "always" entry comes back
+    t.running.clear();
+    s.noteExit("job", true);
+    s.noteExit("daemon", true);
+    t.run(s, now + std::chrono::seconds(2));
+    REQUIRE(t.started == std::vector<std::string>({ "job", "daemon", "daemon" }));
+    t.run(s, now + std::chrono::seconds(4));
+    REQUIRE(t.started.size() == 3);
+
+    // A failed exit is restarted
+    s.configure({ job, ProcessInfo("daemon", "") }, limits(0));
+    t.run(s, now + std::chrono::seconds(6));
+    REQUIRE(t.started.size() == 4);
+    t.running.erase("job");
+    s.noteExit("job", false);
+    t.run(s, now + std::chrono::seconds(8));
+    REQUIRE(t.started.size() == 5);
+    REQUIRE(t.started.back() == "job");
+}
+
+TEST_CASE("StartupScheduler uses the outcome of each launch", "[scheduler]") {
+    StartupScheduler s;
+    WatchdogSettings settings = limits(1);
+    settings.restartDelayMs = 1000;
+    std::vector<ProcessInfo> procs = { ProcessInfo("missing", ""), ProcessInfo("flaky", ""), ProcessInfo("svc", "") };
+    s.configure(procs, settings);
+    FakeTable t;
+    t.results["missing"] = LaunchResult::Unlaunchable;
+    t.results["flaky"] = LaunchResult::Failed;
+    StartupScheduler::Clock::time_point now = StartupScheduler::Clock::now();
+
+    // Failed launches hold no slot, so svc still starts in the same round
+    t.run(s, now);
+    REQUIRE(t.started == std::vector<std::string>({ "missing", "flaky", "svc" }));
+    REQUIRE(s.hasFailed("missing"));
+    REQUIRE_FALSE(s.hasFailed("flaky"));
+
+    // The failed launch is retried in the next round, then after the restart delay; the unlaunchable entry
+    // is not retried at all
+    t.run(s, now);
+    REQUIRE(t.started == std::vector<std::string>({ "missing", "flaky", "svc", "flaky" }));
+    t.run(s, now + std::chrono::milliseconds(499));
+    REQUIRE(t.started.size() == 4);
+    t.run(s, now + std::chrono::seconds(1));
+    REQUIRE(t.started == std::vector<std::string>({ "missing", "flaky", "svc", "flaky", "flaky" }));
+
+    // A reload gives it another chance
+    t.results.erase("missing");
+    s.configure(procs, settings);
+    t.run(s, now + std::chrono::seconds(5));
+    REQUIRE(std::count(t.started.begin(), t.started.end(), "missing") == 2);
+    REQUIRE(t.running.count("missing") == 1);
+}